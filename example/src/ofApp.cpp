@@ -7,7 +7,9 @@ void ofApp::setup()
     gui.add(mWIntensity.set("WEIGHT_INTENSITY", OFXSALIENCYMAP_DEF_WEIGHT_INTENSITY, 0, 20));
     gui.add(mWColor.set("WEIGHT_COLOT", OFXSALIENCYMAP_DEF_WEIGHT_COLOR, 0, 20));
     gui.add(mWOrientation.set("WEIGHT_ORIENTATION", OFXSALIENCYMAP_DEF_WEIGHT_ORIENTATION, 0, 20));
-    gui.add(mWMotion.set("WEIGHT_MOTION", OFXSALIENCYMAP_DEF_WEIGHT_MOTION, 0, 20));
+    
+    // the loaded images are unrelated stills: motion between them is noise
+    saliencyMap.removeChannel(saliencyMap.getChannel("motion"));
 }
 
 void ofApp::update()
@@ -89,7 +91,6 @@ void ofApp::recompute()
         saliencyMap.setWeightIntensity( mWIntensity );
         saliencyMap.setWeightColor( mWColor );
         saliencyMap.setWeightOrientation( mWOrientation );
-        saliencyMap.setWeightMotion( mWMotion );
         
         saliencyMap.createSaliencyMap();
         
@@ -24,7 +24,6 @@ public:
     ofParameter<float> mWIntensity;
     ofParameter<float> mWColor;
     ofParameter<float> mWOrientation;
-    ofParameter<float> mWMotion;
     
     ofxPanel gui;
 };
@@ -0,0 +1,115 @@
+#include "ImageLoader.h"
+
+ImageLoader::ImageLoader()
+{
+    nextDecode = 0;
+    nextDeliver = 0;
+    prefetch = 1;
+    stopping = false;
+    waitSeconds = 0;
+}
+
+ImageLoader::~ImageLoader()
+{
+    stop();
+}
+
+void ImageLoader::setup(const vector<string> & paths, int numThreads, int prefetch)
+{
+    stop();
+
+    this->paths = paths;
+    this->prefetch = MAX(1, prefetch);
+    nextDecode = 0;
+    nextDeliver = 0;
+    stopping = false;
+    waitSeconds = 0;
+
+    for (int i=0; i<MAX(1, numThreads); i++) {
+        Worker * worker = new Worker();
+        worker->setup(this);
+        worker->startThread(true, false);
+        workers.push_back(worker);
+    }
+}
+
+void ImageLoader::stop()
+{
+    mutex.lock();
+    stopping = true;
+    for (int i=0; i<workers.size(); i++) workers[i]->stopThread();
+    condition.broadcast();
+    mutex.unlock();
+
+    for (int i=0; i<workers.size(); i++) {
+        workers[i]->waitForThread(false);
+        delete workers[i];
+    }
+    workers.clear();
+
+    for (map<size_t, ofPixels *>::iterator it = ready.begin(); it != ready.end(); ++it) delete it->second;
+    ready.clear();
+}
+
+bool ImageLoader::next(ofPixels & pixels, string & path)
+{
+    float start = ofGetElapsedTimef();
+
+    mutex.lock();
+    while (nextDeliver < paths.size() && ready.find(nextDeliver) == ready.end()) condition.wait(mutex);
+    if (nextDeliver >= paths.size()) {
+        mutex.unlock();
+        return false;
+    }
+    ofPixels * decoded = ready[nextDeliver];
+    ready.erase(nextDeliver);
+    path = paths[nextDeliver];
+    nextDeliver++;
+    condition.broadcast();
+    mutex.unlock();
+
+    pixels.swap(*decoded);
+    delete decoded;
+    waitSeconds += ofGetElapsedTimef() - start;
+    return true;
+}
+
+bool ImageLoader::decodeNext()
+{
+    // claim the next file, at most `prefetch` ahead of the consumer
+    mutex.lock();
+    while (!stopping && nextDecode < paths.size() && nextDecode - nextDeliver >= prefetch) condition.wait(mutex);
+    if (stopping || nextDecode >= paths.size()) {
+        mutex.unlock();
+        return false;
+    }
+    size_t index = nextDecode++;
+    mutex.unlock();
+
+    ofPixels * pixels = new ofPixels();
+    if (!ofLoadImage(*pixels, paths[index])) pixels->clear();
+
+    mutex.lock();
+    ready[index] = pixels;
+    condition.broadcast();
+    mutex.unlock();
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////
+// Worker
+//////////////////////////////////////////////////////////////////
+ImageLoader::Worker::Worker()
+{
+    owner = NULL;
+}
+
+void ImageLoader::Worker::setup(ImageLoader * owner)
+{
+    this->owner = owner;
+}
+
+void ImageLoader::Worker::threadedFunction()
+{
+    while (isThreadRunning() && owner->decodeNext()) {}
+}
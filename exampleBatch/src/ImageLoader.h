@@ -0,0 +1,56 @@
+#pragma once
+
+#include "ofMain.h"
+#include "Poco/Condition.h"
+
+// decodes a list of image files on background threads, keeping up to
+// `prefetch` images ahead of the consumer, and hands them out in list order
+class ImageLoader {
+public:
+
+    ImageLoader();
+    ~ImageLoader();
+
+    void setup(const vector<string> & paths, int numThreads, int prefetch);
+    void stop();
+
+    // blocks until the next image is decoded. returns false after the last one;
+    // pixels are left unallocated when the file could not be decoded
+    bool next(ofPixels & pixels, string & path);
+
+    inline float getWaitSeconds(){ return waitSeconds; }	// time next() spent blocked
+
+private:
+
+    class Worker : public ofThread {
+    public:
+
+        Worker();
+
+        void setup(ImageLoader * owner);
+
+    protected:
+
+        void threadedFunction();
+
+    private:
+
+        ImageLoader * owner;
+
+    };
+
+    bool decodeNext();	// false when there is nothing left to decode
+
+    vector<string> paths;
+    size_t nextDecode;
+    size_t nextDeliver;
+    size_t prefetch;
+    map<size_t, ofPixels *> ready;
+    bool stopping;
+    float waitSeconds;
+
+    ofMutex mutex;
+    Poco::Condition condition;
+    vector<Worker *> workers;
+
+};
@@ -0,0 +1,95 @@
+#include "ImageWriter.h"
+
+ImageWriter::ImageWriter()
+{
+    capacity = 1;
+    finishing = false;
+    numFailed = 0;
+    waitSeconds = 0;
+}
+
+ImageWriter::~ImageWriter()
+{
+    finish();
+}
+
+void ImageWriter::setup(int capacity)
+{
+    this->capacity = MAX(1, capacity);
+    finishing = false;
+    startThread(true, false);
+}
+
+void ImageWriter::save(const ofPixels & pixels, const string & path)
+{
+    float start = ofGetElapsedTimef();
+
+    Job job;
+    job.pixels = new ofPixels(pixels);
+    job.path = path;
+
+    lock();
+    while (queue.size() >= capacity) condition.wait(mutex);
+    queue.push_back(job);
+    condition.broadcast();
+    unlock();
+
+    waitSeconds += ofGetElapsedTimef() - start;
+}
+
+void ImageWriter::finish()
+{
+    if (!isThreadRunning()) return;
+
+    lock();
+    finishing = true;
+    condition.broadcast();
+    unlock();
+    waitForThread(false);
+}
+
+bool ImageWriter::write(ofPixels & pixels, const string & path)
+{
+    // ofSaveImage() does not report failures, and a file left by an earlier run would hide them:
+    // write a fresh temporary file (same extension, so the same format) and move it over the target
+    string temp = ofFilePath::removeExt(path) + ".partial." + ofFilePath::getFileExt(path);
+    if (ofFile::doesFileExist(temp, false)) ofFile::removeFile(temp, false);
+    ofSaveImage(pixels, temp);
+    if (!ofFile::doesFileExist(temp, false) || ofFile(temp, ofFile::Reference).getSize() == 0) {
+        ofLogError("exampleBatch") << "cannot write " << path;
+        ofFile::removeFile(temp, false);
+        return false;
+    }
+    if (!ofFile::moveFromTo(temp, path, false, true)) {
+        ofLogError("exampleBatch") << "cannot replace " << path;
+        ofFile::removeFile(temp, false);
+        return false;
+    }
+    return true;
+}
+
+void ImageWriter::threadedFunction()
+{
+    while (isThreadRunning()) {
+
+        lock();
+        while (queue.empty() && !finishing) condition.wait(mutex);
+        if (queue.empty()) {
+            unlock();
+            break;
+        }
+        Job job = queue.front();
+        unlock();
+
+        if (!write(*job.pixels, job.path)) numFailed++;
+        delete job.pixels;
+
+        // free the slot only once the file is written, so that capacity bounds the memory held
+        lock();
+        queue.pop_front();
+        condition.broadcast();
+        unlock();
+
+    }
+    stopThread();
+}
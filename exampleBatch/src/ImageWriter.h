@@ -0,0 +1,42 @@
+#pragma once
+
+#include "ofMain.h"
+#include "Poco/Condition.h"
+#include <deque>
+
+// encodes and saves images on a background thread. save() only blocks while
+// `capacity` images are already queued, so a slow disk throttles the producer
+class ImageWriter : public ofThread {
+public:
+
+    ImageWriter();
+    ~ImageWriter();
+
+    void setup(int capacity);
+    void save(const ofPixels & pixels, const string & path);	// queues a copy
+    void finish();	// writes everything queued, then stops the thread
+
+    inline int getNumFailed(){ return numFailed; }
+    inline float getWaitSeconds(){ return waitSeconds; }	// time save() spent blocked
+
+protected:
+
+    void threadedFunction();
+
+private:
+
+    bool write(ofPixels & pixels, const string & path);
+
+    struct Job {
+        ofPixels * pixels;
+        string path;
+    };
+
+    deque<Job> queue;
+    size_t capacity;
+    bool finishing;
+    int numFailed;
+    float waitSeconds;
+    Poco::Condition condition;
+
+};
@@ -0,0 +1,88 @@
+#include "ofMain.h"
+#include "ofAppNoWindow.h"
+#include "ofApp.h"
+
+static void printUsage()
+{
+    cout << "usage: exampleBatch [options] <input>..." << endl;
+    cout << "  <input>           image file, directory of images, or printf frame pattern (frames/%05d.jpg)" << endl;
+    cout << "  -o <dir>          output directory (default: saliency)" << endl;
+    cout << "  --ext <ext>       output format (default: png)" << endl;
+    cout << "  --threads <n>     decode threads (default: 2)" << endl;
+    cout << "  --channel-threads <n>   threads computing the channels of each image (default: 0, on the main thread)" << endl;
+    cout << "  --prefetch <n>    images decoded ahead (default: 8)" << endl;
+    cout << "  --sequence        inputs are consecutive frames of one video (enables the motion channel, implied by frame patterns)" << endl;
+    cout << "  --low-memory      low-memory mode of ofxSaliencyMap" << endl;
+    cout << "  --scales <set>    auto, default, vga, qvga or qqvga (default: auto)" << endl;
+    cout << "  --archive <file>  also store all maps in one sequence file (first image sets the size)" << endl;
+    cout << "  --archive-depth <8|16>  quantization of the archive (default: 8)" << endl;
+    cout << "  --archive-level <n>     archive at pyramid level n (default: 0, full size)" << endl;
+    cout << "  --archive-conspicuity   archive the conspicuity map of every channel too" << endl;
+}
+
+// the pattern goes to snprintf() with one int: exactly one %d with an optional zero flag and
+// width (%5d, %05d), any other % escaped as %%
+static bool isFramePattern(const string & pattern)
+{
+    int conversions = 0;
+    for (int i=0; i<pattern.size(); i++) {
+        
+        if (pattern[i] != '%') continue;
+        if (++i < pattern.size() && pattern[i] == '%') continue;
+        while (i < pattern.size() && isdigit(pattern[i])) i++;
+        if (i >= pattern.size() || pattern[i] != 'd') return false;
+        conversions++;
+        
+    }
+    return conversions == 1;
+}
+
+//========================================================================
+int main(int argc, char * argv[]){
+    
+    BatchSettings settings;
+    for (int i=1; i<argc; i++) {
+        
+        string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "-h" || arg == "--help") { printUsage(); return 0; }
+        else if (arg == "-o" && hasValue) settings.output = argv[++i];
+        else if (arg == "--ext" && hasValue) settings.extension = argv[++i];
+        else if (arg == "--threads" && hasValue) settings.decodeThreads = ofToInt(argv[++i]);
+        else if (arg == "--channel-threads" && hasValue) settings.channelThreads = ofToInt(argv[++i]);
+        else if (arg == "--prefetch" && hasValue) settings.prefetch = ofToInt(argv[++i]);
+        else if (arg == "--sequence") settings.sequence = true;
+        else if (arg == "--low-memory") settings.lowMemory = true;
+        else if (arg == "--scales" && hasValue) {
+            string scales = ofToLower(argv[++i]);
+            if (scales == "auto") settings.scales = OFXSALIENCYMAP_SCALES_AUTO;
+            else if (scales == "vga") settings.scales = OFXSALIENCYMAP_SCALES_VGA;
+            else if (scales == "qvga") settings.scales = OFXSALIENCYMAP_SCALES_QVGA;
+            else if (scales == "qqvga") settings.scales = OFXSALIENCYMAP_SCALES_QQVGA;
+            else if (scales == "default") settings.scales = OFXSALIENCYMAP_SCALES_DEFAULT;
+            else { cout << "unknown scale set " << argv[i] << endl; printUsage(); return 1; }
+        }
+        else if (arg == "--archive" && hasValue) settings.archive = ofFilePath::getAbsolutePath(argv[++i], false);
+        else if (arg == "--archive-depth" && hasValue) settings.archiveDepth = ofToInt(argv[++i]);
+        else if (arg == "--archive-level" && hasValue) settings.archiveLevel = ofToInt(argv[++i]);
+        else if (arg == "--archive-conspicuity") settings.archiveConspicuity = true;
+        else if (arg.size() > 1 && arg[0] == '-') { printUsage(); return 1; }
+        else if (arg.find('%') != string::npos && !isFramePattern(arg)) {
+            cout << "frame pattern needs exactly one integer conversion (%d, %Nd or %0Nd, %% for a literal %): " << arg << endl;
+            printUsage();
+            return 1;
+        }
+        else {
+            // paths are relative to the working directory, not to bin/data
+            settings.inputs.push_back(ofFilePath::getAbsolutePath(arg, false));
+        }
+        
+    }
+    if (settings.inputs.empty()) { printUsage(); return 1; }
+    settings.output = ofFilePath::getAbsolutePath(settings.output, false);
+    
+    ofAppNoWindow window;
+    ofSetupOpenGL(&window, 0, 0, OF_WINDOW);			// <-------- no GL context, only the main loop
+    ofRunApp(new ofApp(settings));
+    
+}
@@ -0,0 +1,214 @@
+#include "ofApp.h"
+
+static const int BATCH_WRITE_QUEUE  = 16;
+static const int BATCH_REPORT_EVERY = 100;
+
+BatchSettings::BatchSettings()
+{
+    output = "saliency";
+    extension = "png";
+    decodeThreads = 2;
+    channelThreads = 0;
+    prefetch = 8;
+    sequence = false;
+    lowMemory = false;
+    scales = OFXSALIENCYMAP_SCALES_AUTO;
+    archiveDepth = 8;
+    archiveLevel = 0;
+    archiveConspicuity = false;
+}
+
+ofApp::ofApp(const BatchSettings & settings)
+{
+    this->settings = settings;
+    numProcessed = 0;
+    numFailed = 0;
+    startTime = 0;
+    computeSeconds = 0;
+}
+
+void ofApp::setup()
+{
+    collectInputs();
+    if (paths.empty()) {
+        ofLogError("exampleBatch") << "no input images found";
+        ofExit(1);
+        return;
+    }
+    if (!checkOutputPaths()) {
+        ofExit(1);
+        return;
+    }
+    if (!ofDirectory::doesDirectoryExist(settings.output, false) &&
+        !ofDirectory::createDirectory(settings.output, false, true)) {
+        ofLogError("exampleBatch") << "cannot create output directory " << settings.output;
+        ofExit(1);
+        return;
+    }
+    
+    // no GL context here
+    saliencyMap.setUseTexture(false);
+    saliencyMap.setScaleSet(settings.scales);
+    saliencyMap.setLowMemoryEnabled(settings.lowMemory);
+    saliencyMap.setNumThreads(settings.channelThreads);
+    saliencyMap.setFloatOutputEnabled(!settings.archive.empty());
+    
+    // motion between unrelated stills is noise
+    if (!settings.sequence) saliencyMap.removeChannel(saliencyMap.getChannel("motion"));
+    
+    ofLogNotice("exampleBatch") << paths.size() << " images, " << settings.decodeThreads << " decode threads, "
+                                << saliencyMap.getNumThreads() << " channel threads";
+    
+    writer.setup(BATCH_WRITE_QUEUE);
+    loader.setup(paths, settings.decodeThreads, settings.prefetch);
+    startTime = ofGetElapsedTimef();
+}
+
+void ofApp::update()
+{
+    ofPixels pixels;
+    string path;
+    if (!loader.next(pixels, path)) {
+        finish();
+        return;
+    }
+    
+    if (!pixels.isAllocated()) {
+        ofLogError("exampleBatch") << "cannot decode " << path;
+        numFailed++;
+        return;
+    }
+    pixels.setImageType(OF_IMAGE_COLOR);
+    
+    float start = ofGetElapsedTimef();
+    saliencyMap.setSourceImage(pixels);
+    saliencyMap.createSaliencyMap();
+    computeSeconds += ofGetElapsedTimef() - start;
+    
+    writer.save(saliencyMap.getSaliencyMapRef().getPixelsRef(), getOutputPath(path));
+    if (!settings.archive.empty()) archiveFrame(path);
+    numProcessed++;
+    
+    if (numProcessed % BATCH_REPORT_EVERY == 0) {
+        float elapsed = ofGetElapsedTimef() - startTime;
+        ofLogNotice("exampleBatch") << numProcessed << " / " << paths.size() << " images, "
+                                    << numProcessed / MAX(elapsed, 0.001f) << " images/s";
+    }
+}
+
+void ofApp::exit()
+{
+    loader.stop();
+    writer.finish();
+    archive.close();
+}
+
+void ofApp::archiveFrame(const string & path)
+{
+    // the archive takes the size of its first frame
+    const ofFloatPixels & map = saliencyMap.getSaliencyMapFloat();
+    if (!archive.isOpen()) {
+        vector<string> planes;
+        planes.push_back("saliency");
+        if (settings.archiveConspicuity) {
+            const vector<ofxSaliencyMapChannel *> & channels = saliencyMap.getChannels();
+            for (int i=0; i<channels.size(); i++) planes.push_back(channels[i]->getName());
+        }
+        if (!archive.open(settings.archive, map.getWidth(), map.getHeight(), planes, settings.archiveDepth, settings.archiveLevel)) {
+            settings.archive.clear();
+            numFailed++;
+            return;
+        }
+    }
+    if (!archive.addFrame(saliencyMap, archive.getNumFrames())) {
+        ofLogError("exampleBatch") << "cannot archive " << path;
+        numFailed++;
+    }
+}
+
+void ofApp::collectInputs()
+{
+    for (int i=0; i<settings.inputs.size(); i++) {
+        
+        const string & input = settings.inputs[i];
+        if (input.find('%') != string::npos) {
+            
+            // frame sequence: consecutive numbers from 0 or 1 until the first missing frame
+            settings.sequence = true;
+            char name[1024];
+            int frame = 0;
+            snprintf(name, sizeof(name), input.c_str(), frame);
+            if (!ofFile::doesFileExist(name, false)) frame = 1;
+            for (;; frame++) {
+                snprintf(name, sizeof(name), input.c_str(), frame);
+                if (!ofFile::doesFileExist(name, false)) break;
+                paths.push_back(name);
+            }
+            
+        } else if (ofDirectory::doesDirectoryExist(input, false)) {
+            
+            ofDirectory dir(input);
+            dir.allowExt("jpg");
+            dir.allowExt("jpeg");
+            dir.allowExt("png");
+            dir.allowExt("bmp");
+            dir.allowExt("tif");
+            dir.allowExt("tiff");
+            dir.listDir();
+            dir.sort();
+            for (int j=0; j<dir.size(); j++) paths.push_back(dir.getPath(j));
+            
+        } else if (ofFile::doesFileExist(input, false)) {
+            
+            paths.push_back(input);
+            
+        } else {
+            
+            ofLogWarning("exampleBatch") << "skipping missing input " << input;
+            
+        }
+        
+    }
+}
+
+string ofApp::getOutputPath(const string & path)
+{
+    return ofFilePath::join(settings.output, ofFilePath::getBaseName(path) + "." + settings.extension);
+}
+
+bool ofApp::checkOutputPaths()
+{
+    // maps are named after the input file only, so inputs from different directories (or with
+    // different extensions) may not share a base name. compared case-insensitively, like most
+    // desktop file systems do
+    map<string, string> outputs;
+    for (int i=0; i<paths.size(); i++) {
+        
+        string output = getOutputPath(paths[i]);
+        map<string, string>::iterator it = outputs.find(ofToLower(output));
+        if (it != outputs.end()) {
+            ofLogError("exampleBatch") << paths[i] << " and " << it->second << " would both be written to " << output;
+            return false;
+        }
+        outputs[ofToLower(output)] = paths[i];
+        
+    }
+    return true;
+}
+
+void ofApp::finish()
+{
+    writer.finish();
+    if (!archive.close()) numFailed++;
+    numFailed += writer.getNumFailed();
+    
+    float elapsed = ofGetElapsedTimef() - startTime;
+    ofLogNotice("exampleBatch") << numProcessed << " images in " << elapsed << " s: "
+                                << numProcessed / MAX(elapsed, 0.001f) << " images/s ("
+                                << computeSeconds << " s compute, "
+                                << loader.getWaitSeconds() << " s waiting for decode, "
+                                << writer.getWaitSeconds() << " s waiting for writes)";
+    if (numFailed > 0) ofLogError("exampleBatch") << numFailed << " images failed";
+    
+    ofExit(numFailed > 0 ? 1 : 0);
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "ofMain.h"
+#include "ofxSaliencyMap.h"
+#include "ofxSaliencyMapSequence.h"
+#include "ImageLoader.h"
+#include "ImageWriter.h"
+
+// command line settings, see printUsage() in main.cpp
+struct BatchSettings {
+    
+    BatchSettings();
+    
+    vector<string> inputs;	// image files, directories or printf frame patterns (frames/%05d.jpg)
+    string output;
+    string extension;
+    int decodeThreads;
+    int channelThreads;	// scheduler threads of ofxSaliencyMap
+    int prefetch;
+    bool sequence;	// inputs are consecutive frames: keep the motion channel
+    bool lowMemory;
+    ofxSaliencyMapScaleSet scales;
+    string archive;	// sequence file of all maps (see ofxSaliencyMapSequence.h), empty for none
+    int archiveDepth;
+    int archiveLevel;
+    bool archiveConspicuity;
+    
+};
+
+// headless batch run: one image per update(), decoded ahead on the loader
+// threads and written behind on the writer thread
+class ofApp : public ofBaseApp{
+    
+public:
+    ofApp(const BatchSettings & settings);
+    
+    void setup();
+    void update();
+    void exit();
+    
+private:
+    void collectInputs();
+    bool checkOutputPaths();	// false if two inputs map to the same output file
+    string getOutputPath(const string & path);
+    void archiveFrame(const string & path);
+    void finish();
+    
+    BatchSettings settings;
+    vector<string> paths;
+    
+    ofxSaliencyMap saliencyMap;
+    ImageLoader loader;
+    ImageWriter writer;
+    ofxSaliencyMapSequenceWriter archive;
+    
+    int numProcessed;
+    int numFailed;
+    float startTime;
+    float computeSeconds;
+};
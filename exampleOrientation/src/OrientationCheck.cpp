@@ -0,0 +1,116 @@
+#include "OrientationCheck.h"
+
+static const int ORIENTATION_CHECK_WIDTH    = 320;
+static const int ORIENTATION_CHECK_HEIGHT   = 240;
+static const int ORIENTATION_CHECK_LEVELS   = 4;
+static const int ORIENTATION_CHECK_REPEATS  = 20;	// filter() calls per engine and level for the timing
+
+// a colored disc over a checkerboard gradient, as intensity
+static CvMat * createImage()
+{
+    CvMat * image = SMCreateMat(ORIENTATION_CHECK_HEIGHT, ORIENTATION_CHECK_WIDTH, CV_32FC1);
+    float cx = ORIENTATION_CHECK_WIDTH * 0.6f;
+    float cy = ORIENTATION_CHECK_HEIGHT * 0.4f;
+    float radius = ORIENTATION_CHECK_HEIGHT * 0.12f;
+    for (int y=0; y<ORIENTATION_CHECK_HEIGHT; y++) {
+        for (int x=0; x<ORIENTATION_CHECK_WIDTH; x++) {
+
+            bool checker = ((x / 16) + (y / 16)) % 2 == 0;
+            float shade = 64 + 96 * x / ORIENTATION_CHECK_WIDTH + (checker ? 32 : 0);
+            float value = (2 * shade + 64 + 96 * y / ORIENTATION_CHECK_HEIGHT) / 3;
+            float dx = x - cx;
+            float dy = y - cy;
+            if (dx * dx + dy * dy < radius * radius) value = (240 + 40 + 20) / 3.0f;
+            cvmSet(image, y, x, value / 255);
+
+        }
+    }
+    return image;
+}
+
+// milliseconds per filter() call of an engine, and its responses
+static float filterTimed(ofxSaliencyMapOrientation & engine, CvMat * src, CvMat * dst[])
+{
+    unsigned long long start = ofGetElapsedTimeMicros();
+    for (int r=0; r<ORIENTATION_CHECK_REPEATS; r++) {
+        engine.filter(src, dst);
+        if (r + 1 == ORIENTATION_CHECK_REPEATS) break;
+        for (int i=0; i<engine.getNumOrientations(); i++) SMReleaseMat(&dst[i]);
+    }
+    return (ofGetElapsedTimeMicros() - start) / 1000.0f / ORIENTATION_CHECK_REPEATS;
+}
+
+static int fail(const string & message)
+{
+    ofLogError("exampleOrientation") << message;
+    return 1;
+}
+
+int runOrientationChecks()
+{
+
+    int failures = 0;
+    double tolerance = OFXSALIENCYMAP_DEF_ORIENTATION_TOLERANCE;
+    ofxSaliencyMapOrientation dense;
+    ofxSaliencyMapOrientation separable;
+    dense.setup(OFXSALIENCYMAP_ORIENTATION_DENSE);
+    if (!separable.setup(OFXSALIENCYMAP_ORIENTATION_SEPARABLE)) failures += fail("the separable engine rejects the default angles");
+
+    // the kernels in use
+    if (!dense.checkFidelity(0)) failures += fail("dense kernels differ from their references");
+    if (!separable.checkFidelity(tolerance)) failures += fail("separable kernels miss the tolerance");
+    for (int i=0; i<separable.getNumOrientations(); i++) {
+        ofLogNotice("exampleOrientation") << separable.getOrientation(i) << " degrees: kernel error " << separable.getFidelityError(i);
+    }
+
+    // and the work per pixel
+    ofLogNotice("exampleOrientation") << "multiply-adds per pixel: dense " << dense.getMultiplyAdds()
+                                      << ", separable " << separable.getMultiplyAdds();
+    if (separable.getMultiplyAdds() >= dense.getMultiplyAdds()) failures += fail("the separable engine is not cheaper");
+
+    // the responses on every level of the image pyramid
+    CvMat * level = createImage();
+    for (int l=0; l<ORIENTATION_CHECK_LEVELS; l++)
+    {
+
+        CvMat * denseOutput[OFXSALIENCYMAP_MAX_ORIENTATIONS];
+        CvMat * separableOutput[OFXSALIENCYMAP_MAX_ORIENTATIONS];
+        float denseTime = filterTimed(dense, level, denseOutput);
+        float separableTime = filterTimed(separable, level, separableOutput);
+        ofLogNotice("exampleOrientation") << "level " << l << " (" << level->cols << "x" << level->rows << "): dense "
+                                          << denseTime << " ms, separable " << separableTime << " ms";
+
+        for (int i=0; i<dense.getNumOrientations(); i++) {
+            double error = cvNorm(separableOutput[i], denseOutput[i], CV_L2) / MAX(cvNorm(denseOutput[i], NULL, CV_L2), 1e-12);
+            if (error > tolerance) {
+                failures += fail("level " + ofToString(l) + ", " + ofToString(dense.getOrientation(i)) + " degrees: relative response error "
+                                 + ofToString(error));
+            }
+            SMReleaseMat(&denseOutput[i]);
+            SMReleaseMat(&separableOutput[i]);
+        }
+
+        CvMat * down = SMCreateMat(level->rows / 2, level->cols / 2, CV_32FC1);
+        cvPyrDown(level, down, CV_GAUSSIAN_5x5);
+        SMReleaseMat(&level);
+        level = down;
+
+    }
+    SMReleaseMat(&level);
+
+    // angles without a table are for the dense engine only
+    vector<float> angles;
+    angles.push_back(0);
+    angles.push_back(30);
+    if (separable.setOrientations(angles) || separable.getNumOrientations() != 4) {
+        failures += fail("the separable engine accepted 30 degrees");
+    }
+    if (!dense.setOrientations(angles) || dense.getNumOrientations() != 2) failures += fail("the dense engine rejected 30 degrees");
+    if (!dense.setOrientations(vector<float>()) || dense.getNumOrientations() != 4) {
+        failures += fail("an empty list does not restore the default angles");
+    }
+
+    if (failures == 0) ofLogNotice("exampleOrientation") << "orientation checks passed";
+    return failures;
+
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+#include "ofMain.h"
+#include "ofxSaliencyMap.h"
+
+// separable against dense orientation filtering: kernel fidelity, the responses on the
+// levels of a synthetic image pyramid, the cost per pixel, and the angles the separable
+// engine must reject. returns the number of failed checks
+int runOrientationChecks();
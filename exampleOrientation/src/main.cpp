@@ -0,0 +1,18 @@
+#include "ofMain.h"
+#include "OrientationCheck.h"
+
+//========================================================================
+int main(int argc, char * argv[]){
+    
+    if (argc > 1) {
+        cout << "usage: exampleOrientation" << endl;
+        cout << "  compares the separable orientation engine with dense filtering. exits with 1 on any failure" << endl;
+        return string(argv[1]) == "-h" || string(argv[1]) == "--help" ? 0 : 1;
+    }
+    
+    // no window and no main loop: the checks run once
+    int failures = runOrientationChecks();
+    if (failures > 0) ofLogError("exampleOrientation") << failures << " failures";
+    return failures > 0 ? 1 : 0;
+    
+}
@@ -0,0 +1,199 @@
+#include "SequenceCheck.h"
+
+static const int SEQUENCE_CHECK_WIDTH   = 67;	// odd, so that every pyramid level rounds down
+static const int SEQUENCE_CHECK_HEIGHT  = 45;
+static const int SEQUENCE_CHECK_FRAMES  = 3;
+static const int SEQUENCE_CHECK_PLANES  = 2;
+
+// a 0-1 pattern that differs per frame and plane and has hard edges
+static void makePlane(int frame, int plane, ofFloatPixels & dst)
+{
+    dst.allocate(SEQUENCE_CHECK_WIDTH, SEQUENCE_CHECK_HEIGHT, OF_IMAGE_GRAYSCALE);
+    float * data = dst.getPixels();
+    for (int y=0; y<SEQUENCE_CHECK_HEIGHT; y++) {
+        for (int x=0; x<SEQUENCE_CHECK_WIDTH; x++) {
+            data[y * SEQUENCE_CHECK_WIDTH + x] = ((x * 7 + y * 3 + frame * 11 + plane * 5) % 97) / 96.0f;
+        }
+    }
+}
+
+// the plane the writer is expected to store: reduced like the Gaussian pyramid
+static void reducePlane(const ofFloatPixels & src, int level, ofFloatPixels & dst)
+{
+    CvMat srcHeader;
+    cvInitMatHeader(&srcHeader, src.getHeight(), src.getWidth(), CV_32FC1, (void *)src.getPixels());
+    CvMat * reduced = SMCloneMat(&srcHeader);
+    for (int l=0; l<level; l++) {
+        CvMat * down = SMCreateMat(reduced->rows / 2, reduced->cols / 2, CV_32FC1);
+        cvPyrDown(reduced, down, CV_GAUSSIAN_5x5);
+        SMReleaseMat(&reduced);
+        reduced = down;
+    }
+
+    dst.allocate(reduced->cols, reduced->rows, OF_IMAGE_GRAYSCALE);
+    CvMat dstHeader;
+    cvInitMatHeader(&dstHeader, reduced->rows, reduced->cols, CV_32FC1, dst.getPixels());
+    cvCopy(reduced, &dstHeader);
+    SMReleaseMat(&reduced);
+}
+
+static bool writeSequence(const string & path, int bitDepth, int level)
+{
+    vector<string> names;
+    names.push_back("saliency");
+    names.push_back("motion");
+
+    ofxSaliencyMapSequenceWriter writer;
+    if (!writer.open(path, SEQUENCE_CHECK_WIDTH, SEQUENCE_CHECK_HEIGHT, names, bitDepth, level)) return false;
+
+    vector<ofFloatPixels> planes(SEQUENCE_CHECK_PLANES);
+    vector<const ofFloatPixels *> frame(SEQUENCE_CHECK_PLANES);
+    for (int f=0; f<SEQUENCE_CHECK_FRAMES; f++) {
+        for (int p=0; p<SEQUENCE_CHECK_PLANES; p++) {
+            makePlane(f, p, planes[p]);
+            frame[p] = &planes[p];
+        }
+        if (!writer.addFrame(frame, f * 0.5)) return false;
+    }
+    return writer.close();
+}
+
+// the first numFrames frames of a file written by writeSequence(), as errors
+static string checkSequence(ofxSaliencyMapSequenceReader & reader, int bitDepth, int level, int numFrames)
+{
+    if (reader.getNumFrames() != numFrames) {
+        return ofToString(reader.getNumFrames()) + " frames, expected " + ofToString(numFrames);
+    }
+    if (reader.getWidth() != SEQUENCE_CHECK_WIDTH || reader.getHeight() != SEQUENCE_CHECK_HEIGHT ||
+        reader.getStoredWidth() != SEQUENCE_CHECK_WIDTH >> level || reader.getStoredHeight() != SEQUENCE_CHECK_HEIGHT >> level) {
+        return "stored " + ofToString(reader.getStoredWidth()) + "x" + ofToString(reader.getStoredHeight());
+    }
+    if (reader.getBitDepth() != bitDepth || reader.getLevel() != level || reader.getNumPlanes() != SEQUENCE_CHECK_PLANES) {
+        return "header does not match the writer settings";
+    }
+    if (reader.getPlaneIndex("saliency") != 0 || reader.getPlaneIndex("motion") != 1) {
+        return "plane names do not match";
+    }
+
+    // half a quantization step of rounding, plus float noise of the reduction
+    float tolerance = 1.0f / (bitDepth == 16 ? 65535 : 255);
+    ofFloatPixels source, expected, stored;
+    for (int f=0; f<numFrames; f++) {
+        if (reader.getTimestamp(f) != f * 0.5) return "frame " + ofToString(f) + " timestamp " + ofToString(reader.getTimestamp(f));
+        for (int p=0; p<SEQUENCE_CHECK_PLANES; p++) {
+
+            makePlane(f, p, source);
+            reducePlane(source, level, expected);
+            if (!reader.getPlane(f, p, stored)) return "frame " + ofToString(f) + " plane " + ofToString(p) + " is not readable";
+            int size = expected.getWidth() * expected.getHeight();
+            for (int i=0; i<size; i++) {
+                float value = MIN(MAX(expected.getPixels()[i], 0.0f), 1.0f);
+                if (fabs(stored.getPixels()[i] - value) > tolerance) {
+                    return "frame " + ofToString(f) + " plane " + ofToString(p) + " pixel " + ofToString(i) + ": "
+                           + ofToString(stored.getPixels()[i]) + ", expected " + ofToString(value);
+                }
+            }
+
+        }
+    }
+    return "";
+}
+
+// replaces the file with its header edited by edit(), and with its first keepFrames chunks
+// and a part of the next one when keepFrames >= 0
+static bool rewriteSequence(const string & path, int keepFrames, void (*edit)(ofxSaliencyMapSequenceHeader &))
+{
+    string file = ofToDataPath(path);
+    FILE * in = fopen(file.c_str(), "rb");
+    if (in == NULL) return false;
+    vector<char> bytes;
+    char block[4096];
+    size_t read;
+    while ((read = fread(block, 1, sizeof(block), in)) > 0) bytes.insert(bytes.end(), block, block + read);
+    fclose(in);
+    if (bytes.size() < sizeof(ofxSaliencyMapSequenceHeader)) return false;
+
+    ofxSaliencyMapSequenceHeader * header = (ofxSaliencyMapSequenceHeader *)&bytes[0];
+    if (keepFrames >= 0) bytes.resize(MIN((uint64_t)bytes.size(), header->headerBytes + keepFrames * header->chunkBytes + 100));
+    if (edit != NULL) edit(*header);
+
+    FILE * out = fopen(file.c_str(), "wb");
+    if (out == NULL) return false;
+    bool written = fwrite(&bytes[0], 1, bytes.size(), out) == bytes.size();
+    return fclose(out) == 0 && written;
+}
+
+static void widenStoredSize(ofxSaliencyMapSequenceHeader & header)
+{
+    header.storedWidth++;
+}
+
+// 2 bytes per pixel wrap around to a 0 stride in 32 bits
+static void overflowStride(ofxSaliencyMapSequenceHeader & header)
+{
+    header.storedWidth = header.width = 0x80000000u;
+    header.planeStride = 0;
+}
+
+int runSequenceChecks(const string & path)
+{
+
+    int failures = 0;
+    int bitDepths[] = { 8, 16, 8, 16 };
+    int levels[] = { 0, 0, 2, 1 };
+    for (int i=0; i<4; i++)
+    {
+
+        string name = ofToString(bitDepths[i]) + "-bit level " + ofToString(levels[i]) + " sequence";
+        ofxSaliencyMapSequenceReader reader;
+        string error;
+        if (!writeSequence(path, bitDepths[i], levels[i])) error = "cannot be written";
+        else if (!reader.open(path)) error = "cannot be read";
+        else error = checkSequence(reader, bitDepths[i], levels[i], SEQUENCE_CHECK_FRAMES);
+        reader.close();
+        if (!error.empty()) {
+            ofLogError("exampleSequence") << name << ": " << error;
+            failures++;
+        }
+
+    }
+
+    // cut inside the last chunk: the index is gone, the complete chunks are still read
+    {
+
+        ofxSaliencyMapSequenceReader reader;
+        string error;
+        if (!writeSequence(path, 16, 1) || !rewriteSequence(path, SEQUENCE_CHECK_FRAMES - 1, NULL)) error = "cannot be written";
+        else if (!reader.open(path)) error = "cannot be read";
+        else error = checkSequence(reader, 16, 1, SEQUENCE_CHECK_FRAMES - 1);
+        reader.close();
+        if (!error.empty()) {
+            ofLogError("exampleSequence") << "truncated sequence: " << error;
+            failures++;
+        }
+
+    }
+
+    // headers that contradict themselves are rejected
+    void (*edits[])(ofxSaliencyMapSequenceHeader &) = { widenStoredSize, overflowStride };
+    string editNames[] = { "stored size", "plane stride overflow" };
+    for (int i=0; i<2; i++)
+    {
+
+        ofxSaliencyMapSequenceReader reader;
+        string error;
+        if (!writeSequence(path, 16, 0) || !rewriteSequence(path, -1, edits[i])) error = "cannot be written";
+        else if (reader.open(path)) error = "was accepted";
+        reader.close();
+        if (!error.empty()) {
+            ofLogError("exampleSequence") << "sequence with a corrupt " << editNames[i] << ": " << error;
+            failures++;
+        }
+
+    }
+
+    ofFile::removeFile(path);
+    if (failures == 0) ofLogNotice("exampleSequence") << "sequence round trips passed";
+    return failures;
+
+}
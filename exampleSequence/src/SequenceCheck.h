@@ -0,0 +1,10 @@
+#pragma once
+
+#include "ofMain.h"
+#include "ofxSaliencyMap.h"
+#include "ofxSaliencyMapSequence.h"
+
+// write -> read round trip of ofxSaliencyMapSequence files: 8-bit, 16-bit and pyramid level
+// storage, a file truncated in its last frame and a header with inconsistent sizes.
+// works in a temporary file at path, returns the number of failed checks
+int runSequenceChecks(const string & path);
@@ -0,0 +1,20 @@
+#include "ofMain.h"
+#include "SequenceCheck.h"
+
+//========================================================================
+int main(int argc, char * argv[]){
+    
+    if (argc > 2 || (argc == 2 && (string(argv[1]) == "-h" || string(argv[1]) == "--help"))) {
+        cout << "usage: exampleSequence [file]" << endl;
+        cout << "  writes and reads back saliency map sequences in file (default: exampleSequence_check.smseq)," << endl;
+        cout << "  then removes it. exits with 1 on any failure" << endl;
+        return argc > 2 ? 1 : 0;
+    }
+    
+    // no window and no main loop: the checks run once
+    string path = ofFilePath::getAbsolutePath(argc == 2 ? argv[1] : "exampleSequence_check.smseq", false);
+    int failures = runSequenceChecks(path);
+    if (failures > 0) ofLogError("exampleSequence") << failures << " failures";
+    return failures > 0 ? 1 : 0;
+    
+}
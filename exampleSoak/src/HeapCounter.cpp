@@ -0,0 +1,109 @@
+#include "HeapCounter.h"
+#include <new>
+#include <stdlib.h>
+
+#if defined(_MSC_VER)
+#include <windows.h>
+static volatile LONGLONG heapAllocations = 0;
+static inline void countHeapAllocation(){ InterlockedIncrement64(&heapAllocations); }
+#else
+static volatile size_t heapAllocations = 0;
+static inline void countHeapAllocation(){ __sync_fetch_and_add(&heapAllocations, 1); }
+#endif
+
+size_t getHeapAllocations()
+{
+    return (size_t)heapAllocations;
+}
+
+#if defined(__GLIBC__)
+
+// glibc exports its allocator under these names, so the replacements need no dlsym().
+// aligned allocations (memalign, posix_memalign) are not counted. __THROW matches the
+// declarations of <stdlib.h> in every language standard
+extern "C" {
+
+void * __libc_malloc(size_t size) __THROW;
+void * __libc_calloc(size_t count, size_t size) __THROW;
+void * __libc_realloc(void * ptr, size_t size) __THROW;
+
+void * malloc(size_t size) __THROW
+{
+    countHeapAllocation();
+    return __libc_malloc(size);
+}
+
+void * calloc(size_t count, size_t size) __THROW
+{
+    countHeapAllocation();
+    return __libc_calloc(count, size);
+}
+
+void * realloc(void * ptr, size_t size) __THROW
+{
+    countHeapAllocation();
+    return __libc_realloc(ptr, size);
+}
+
+}
+
+#else
+
+// no exception specifications: throw(std::bad_alloc) is ill-formed from C++17 on
+void * operator new(size_t size)
+{
+    countHeapAllocation();
+    void * ptr = malloc(size > 0 ? size : 1);
+    if (ptr == NULL) throw std::bad_alloc();
+    return ptr;
+}
+
+void * operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void * operator new(size_t size, const std::nothrow_t &)
+{
+    countHeapAllocation();
+    return malloc(size > 0 ? size : 1);
+}
+
+void * operator new[](size_t size, const std::nothrow_t &)
+{
+    return operator new(size, std::nothrow);
+}
+
+void operator delete(void * ptr)
+{
+    free(ptr);
+}
+
+void operator delete[](void * ptr)
+{
+    free(ptr);
+}
+
+void operator delete(void * ptr, const std::nothrow_t &)
+{
+    free(ptr);
+}
+
+void operator delete[](void * ptr, const std::nothrow_t &)
+{
+    free(ptr);
+}
+
+#if __cplusplus >= 201402L
+void operator delete(void * ptr, size_t)
+{
+    free(ptr);
+}
+
+void operator delete[](void * ptr, size_t)
+{
+    free(ptr);
+}
+#endif
+
+#endif
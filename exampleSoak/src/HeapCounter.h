@@ -0,0 +1,9 @@
+#pragma once
+
+#include "ofMain.h"
+
+// heap blocks allocated by every thread of the process since it started. compiled into the
+// soak harness only: with glibc malloc(), calloc() and realloc() are replaced (which covers
+// operator new and the OpenCV buffers), elsewhere the global operator new and new[].
+// differences between two calls count the allocations in between
+size_t getHeapAllocations();
@@ -0,0 +1,54 @@
+#include "ofMain.h"
+#include "ofAppNoWindow.h"
+#include "ofApp.h"
+
+static void printUsage()
+{
+    cout << "usage: exampleSoak [options]" << endl;
+    cout << "  --cycles <n>          passes over all phases (default: 10)" << endl;
+    cout << "  --frames <n>          frames per phase (default: 100)" << endl;
+    cout << "  --max-allocs <n>      fail when a frame allocates more matrices (default: 1000)" << endl;
+    cout << "  --max-heap-allocs <n> fail when a frame allocates more heap blocks (default: 5000)" << endl;
+    cout << "  --alloc-slack <pct>   fail when a frame allocates more matrices or heap blocks than in the" << endl;
+    cout << "                        first cycle, plus this percentage (default: 10)" << endl;
+    cout << "  --rss-tolerance <mb>  fail when the resident size grows more over the first cycle (default: 16)" << endl;
+    cout << "  --rss-trend <n>       fail when the resident size grows at n cycle ends in a row (default: 4)" << endl;
+    cout << "  --csv <file>          log memory statistics of every frame" << endl;
+    cout << "exits with 1 on any failure" << endl;
+}
+
+//========================================================================
+int main(int argc, char * argv[]){
+    
+    SoakSettings settings;
+    for (int i=1; i<argc; i++) {
+        
+        string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "-h" || arg == "--help") { printUsage(); return 0; }
+        else if (arg == "--cycles" && hasValue) settings.cycles = ofToInt(argv[++i]);
+        else if (arg == "--frames" && hasValue) settings.frames = ofToInt(argv[++i]);
+        else if (arg == "--max-allocs" && hasValue) settings.maxAllocations = ofToInt(argv[++i]);
+        else if (arg == "--max-heap-allocs" && hasValue) settings.maxHeapAllocations = ofToInt(argv[++i]);
+        else if (arg == "--alloc-slack" && hasValue) settings.allocationSlack = ofToInt(argv[++i]);
+        else if (arg == "--rss-tolerance" && hasValue) settings.rssTolerance = ofToFloat(argv[++i]);
+        else if (arg == "--rss-trend" && hasValue) settings.rssTrend = ofToInt(argv[++i]);
+        else if (arg == "--csv" && hasValue) settings.csv = ofFilePath::getAbsolutePath(argv[++i], false);
+        else { printUsage(); return 1; }
+        
+    }
+    // the first cycle is the baseline, and the first two frames of a phase settle it
+    if (settings.cycles < 2 || settings.frames < 3) {
+        cout << "[ERROR] at least 2 cycles of 3 frames" << endl;
+        return 1;
+    }
+    if (settings.maxAllocations < 1 || settings.maxHeapAllocations < 1 || settings.allocationSlack < 0 || settings.rssTolerance < 0 || settings.rssTrend < 1) {
+        printUsage();
+        return 1;
+    }
+    
+    ofAppNoWindow window;
+    ofSetupOpenGL(&window, 0, 0, OF_WINDOW);			// <-------- no GL context, only the main loop
+    ofRunApp(new ofApp(settings));
+    
+}
@@ -0,0 +1,338 @@
+#include "ofApp.h"
+#include "HeapCounter.h"
+
+#if defined(TARGET_WIN32)
+#include <psapi.h>
+#ifdef _MSC_VER
+#pragma comment(lib, "psapi.lib")
+#endif
+#elif defined(TARGET_OSX)
+#include <mach/mach.h>
+#else
+#include <unistd.h>
+#endif
+
+static const int SOAK_REPORT_EVERY  = 500;
+static const int SOAK_QUERY_POINTS  = 8;
+static const int SOAK_QUERY_SPREAD  = 48;	// pixels between the clustered query points
+static const int SOAK_LIMIT_SLACK   = 2;	// allocations over a limit tolerated on top of the slack percentage
+
+// resident set size of the process, 0 where it cannot be read
+static size_t getResidentBytes()
+{
+#if defined(TARGET_WIN32)
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+    return counters.WorkingSetSize;
+#elif defined(TARGET_OSX)
+    mach_task_basic_info_data_t info;
+    mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+    if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, (task_info_t)&info, &count) != KERN_SUCCESS) return 0;
+    return info.resident_size;
+#else
+    // second field of statm: resident pages
+    FILE * statm = fopen("/proc/self/statm", "r");
+    if (statm == NULL) return 0;
+    unsigned long size = 0, resident = 0;
+    int read = fscanf(statm, "%lu %lu", &size, &resident);
+    fclose(statm);
+    if (read != 2) return 0;
+    return resident * sysconf(_SC_PAGESIZE);
+#endif
+}
+
+static SoakPhase makePhase(const string & name, int width, int height, bool pipeline, bool lowMemory, bool query)
+{
+    SoakPhase phase;
+    phase.name = name;
+    phase.width = width;
+    phase.height = height;
+    phase.pipeline = pipeline;
+    phase.lowMemory = lowMemory;
+    phase.query = query;
+    return phase;
+}
+
+SoakSettings::SoakSettings()
+{
+    cycles = 10;
+    frames = 100;
+    maxAllocations = 1000;
+    maxHeapAllocations = 5000;
+    allocationSlack = 10;
+    rssTolerance = 16;
+    rssTrend = 4;
+}
+
+SoakAllocations::SoakAllocations()
+{
+    frameMats = 0;
+    frameHeap = 0;
+    queryMats = 0;
+    queryHeap = 0;
+}
+
+ofApp::ofApp(const SoakSettings & settings)
+{
+    this->settings = settings;
+    cycle = 0;
+    phase = 0;
+    frame = 0;
+    totalFrames = 0;
+    numFailures = 0;
+    phaseLiveMats = 0;
+    maxAllocations = 0;
+    maxHeapAllocations = 0;
+    bBaseline = false;
+    baselineLiveMats = 0;
+    baselineBytes = 0;
+    baselineResident = 0;
+    lastResident = 0;
+    residentGrowth = 0;
+    startTime = 0;
+}
+
+void ofApp::setup()
+{
+    // resolution changes between phases, including one the pyramid does not divide evenly
+    phases.push_back(makePhase("vga", 640, 480, false, false, false));
+    phases.push_back(makePhase("qvga pipelined", 320, 240, true, false, false));
+    phases.push_back(makePhase("720p low-memory", 1280, 720, false, true, false));
+    phases.push_back(makePhase("svga query", 800, 600, false, false, true));
+    phases.push_back(makePhase("odd pipelined", 333, 251, true, false, false));
+
+    // no GL context here
+    saliencyMap.setUseTexture(false);
+    saliencyMap.setScaleSet(OFXSALIENCYMAP_SCALES_AUTO);
+
+    if (!settings.csv.empty()) {
+        csv.open(settings.csv, ofFile::WriteOnly);
+        csv << "cycle,phase,frame,width,height,allocations,query_allocations,heap_allocations,query_heap_allocations,live_mats,current_bytes,peak_bytes,resident_bytes" << endl;
+    }
+
+    ofLogNotice("exampleSoak") << settings.cycles << " cycles of " << phases.size() << " phases, "
+                               << settings.frames << " frames each, at most " << settings.maxAllocations << " matrices and "
+                               << settings.maxHeapAllocations << " heap blocks per frame, and the first cycle + "
+                               << settings.allocationSlack << "%";
+    startTime = ofGetElapsedTimef();
+}
+
+void ofApp::update()
+{
+    if (cycle >= settings.cycles) {
+        finish();
+        return;
+    }
+
+    SoakPhase & current = phases[phase];
+    if (frame == 0) {
+        saliencyMap.setPipelineEnabled(current.pipeline);
+        saliencyMap.setLowMemoryEnabled(current.lowMemory);
+    }
+
+    renderFrame();
+    SoakAllocations allocations;
+    size_t heap = getHeapAllocations();
+    saliencyMap.setSourceImage(pixels);
+    saliencyMap.createSaliencyMap();
+    allocations.frameHeap = getHeapAllocations() - heap;
+    allocations.frameMats = saliencyMap.getFrameAllocations();
+
+    // a cluster of sparse query points wandering over the frame, counted on their own.
+    // their footprints are shared, so the cluster must cost less than the full frame
+    if (current.query) {
+        float t = frame * 0.05f;
+        ofPoint center((0.5f + 0.3f * cos(t)) * current.width, (0.5f + 0.3f * sin(t)) * current.height);
+        vector<ofPoint> points;
+        for (int i=0; i<SOAK_QUERY_POINTS; i++) {
+            points.push_back(ofPoint(center.x + (i % 3 - 1) * SOAK_QUERY_SPREAD, center.y + (i / 3 - 1) * SOAK_QUERY_SPREAD));
+        }
+        ofxSaliencyMapMemoryScope queryMemory;
+        heap = getHeapAllocations();
+        {
+            ofxSaliencyMapMemoryBinding binding(&queryMemory);
+            saliencyMap.querySaliency(points);
+        }
+        allocations.queryHeap = getHeapAllocations() - heap;
+        allocations.queryMats = queryMemory.getStats().allocations;
+
+        size_t fullFrame = (size_t)current.width * current.height;
+        if (saliencyMap.getQueryPixels() >= fullFrame) {
+            fail(current.name + " query " + ofToString(frame) + " computed " + ofToString(saliencyMap.getQueryPixels())
+                 + " pixels for " + ofToString(SOAK_QUERY_POINTS) + " clustered points, a full frame is " + ofToString(fullFrame));
+        }
+    }
+
+    checkFrame(current, allocations);
+    totalFrames++;
+    if (totalFrames % SOAK_REPORT_EVERY == 0) {
+        ofLogNotice("exampleSoak") << totalFrames << " frames, " << numFailures << " failures, "
+                                   << SMGetMemoryStats().liveMats << " live matrices, "
+                                   << getResidentBytes() / (1024 * 1024) << " MB resident";
+    }
+
+    if (++frame < settings.frames) return;
+    frame = 0;
+    if (++phase < phases.size()) return;
+    phase = 0;
+    checkCycle();
+    cycle++;
+}
+
+void ofApp::exit()
+{
+    csv.close();
+}
+
+void ofApp::renderFrame()
+{
+    // a colored disc moving over a static checkerboard-gradient background
+    const SoakPhase & current = phases[phase];
+    int width = current.width;
+    int height = current.height;
+    pixels.allocate(width, height, OF_IMAGE_COLOR);
+
+    float t = frame * 0.1f;
+    float cx = (0.5f + 0.35f * cos(t)) * width;
+    float cy = (0.5f + 0.35f * sin(t * 1.3f)) * height;
+    float radius = MIN(width, height) * 0.12f;
+    unsigned char * data = pixels.getPixels();
+    for (int y=0; y<height; y++) {
+        for (int x=0; x<width; x++) {
+
+            unsigned char * px = data + (y * width + x) * 3;
+            bool checker = ((x / 16) + (y / 16)) % 2 == 0;
+            unsigned char shade = (unsigned char)(64 + 96 * x / width + (checker ? 32 : 0));
+            px[0] = shade;
+            px[1] = shade;
+            px[2] = (unsigned char)(64 + 96 * y / height);
+            float dx = x - cx;
+            float dy = y - cy;
+            if (dx * dx + dy * dy < radius * radius) {
+                px[0] = 240;
+                px[1] = 40;
+                px[2] = 20;
+            }
+
+        }
+    }
+}
+
+void ofApp::checkFrame(SoakPhase & current, const SoakAllocations & allocations)
+{
+    ofxSaliencyMapMemoryStats memory = SMGetMemoryStats();
+    size_t resident = getResidentBytes();
+    maxAllocations = MAX(maxAllocations, MAX(allocations.frameMats, allocations.queryMats));
+    maxHeapAllocations = MAX(maxHeapAllocations, MAX(allocations.frameHeap, allocations.queryHeap));
+
+    // the first cycle sets the limits of every phase. the heap blocks of a pipelined frame
+    // are allocated by the worker while the caller is between frames, so they are not limited
+    SoakAllocations & limit = current.limits[frame < 2 ? 0 : 1];
+    if (cycle == 0) {
+        limit.frameMats = MAX(limit.frameMats, allocations.frameMats);
+        limit.frameHeap = MAX(limit.frameHeap, allocations.frameHeap);
+        limit.queryMats = MAX(limit.queryMats, allocations.queryMats);
+        limit.queryHeap = MAX(limit.queryHeap, allocations.queryHeap);
+    }
+    string frameName = current.name + " frame " + ofToString(frame);
+    string queryName = current.name + " query " + ofToString(frame);
+    checkLimit(frameName, "matrices", allocations.frameMats, limit.frameMats, settings.maxAllocations);
+    if (!current.pipeline) checkLimit(frameName, "heap blocks", allocations.frameHeap, limit.frameHeap, settings.maxHeapAllocations);
+    checkLimit(queryName, "matrices", allocations.queryMats, limit.queryMats, settings.maxAllocations);
+    checkLimit(queryName, "heap blocks", allocations.queryHeap, limit.queryHeap, settings.maxHeapAllocations);
+
+    // without a frame in flight, the live matrices are constant from the second frame of a
+    // phase on (the first one of a new resolution has no previous motion frame yet)
+    if (!current.pipeline) {
+        if (frame == 1) phaseLiveMats = memory.liveMats;
+        else if (frame > 1 && memory.liveMats != phaseLiveMats) {
+            fail(current.name + " frame " + ofToString(frame) + ": " + ofToString(memory.liveMats)
+                 + " live matrices, " + ofToString(phaseLiveMats) + " at frame 1");
+            phaseLiveMats = memory.liveMats;
+        }
+    }
+
+    if (csv.is_open()) {
+        csv << cycle << "," << current.name << "," << frame << "," << current.width << "," << current.height << ","
+            << allocations.frameMats << "," << allocations.queryMats << ","
+            << allocations.frameHeap << "," << allocations.queryHeap << "," << memory.liveMats << ","
+            << memory.currentBytes << "," << memory.peakBytes << "," << resident << endl;
+    }
+}
+
+void ofApp::checkCycle()
+{
+    // every cycle ends in the same state: last phase delivered, same size and motion pair
+    saliencyMap.flushPipeline();
+    ofxSaliencyMapMemoryStats memory = SMGetMemoryStats();
+    size_t resident = getResidentBytes();
+
+    // the first cycle warms up caches, filter banks and allocators
+    if (!bBaseline) {
+        bBaseline = true;
+        baselineLiveMats = memory.liveMats;
+        baselineBytes = memory.currentBytes;
+        baselineResident = resident;
+        lastResident = resident;
+        ofLogNotice("exampleSoak") << "baseline: " << baselineLiveMats << " live matrices, "
+                                   << baselineBytes << " bytes, " << baselineResident / (1024 * 1024) << " MB resident";
+        return;
+    }
+
+    if (memory.liveMats != baselineLiveMats || memory.currentBytes != baselineBytes) {
+        fail("cycle " + ofToString(cycle) + ": " + ofToString(memory.liveMats) + " live matrices ("
+             + ofToString(memory.currentBytes) + " bytes), baseline " + ofToString(baselineLiveMats)
+             + " (" + ofToString(baselineBytes) + " bytes)");
+    }
+
+    // 0: not available on this platform
+    size_t tolerance = settings.rssTolerance * 1024 * 1024;
+    if (resident > 0 && baselineResident > 0 && resident > baselineResident + tolerance) {
+        fail("cycle " + ofToString(cycle) + ": " + ofToString(resident / (1024 * 1024)) + " MB resident, baseline "
+             + ofToString(baselineResident / (1024 * 1024)) + " MB");
+    }
+
+    // a leak too small for the tolerance still grows the resident size at every cycle end
+    if (resident > 0 && lastResident > 0) {
+        residentGrowth = resident > lastResident ? residentGrowth + 1 : 0;
+        if (residentGrowth >= settings.rssTrend) {
+            fail("cycle " + ofToString(cycle) + ": resident size grew at " + ofToString(residentGrowth)
+                 + " cycle ends in a row, now " + ofToString(resident / 1024) + " KB");
+            residentGrowth = 0;
+        }
+    }
+    lastResident = resident;
+}
+
+// the fixed ceiling holds for every release, whatever this run allocated in its first cycle.
+// the first-cycle limit catches growth within the run, below the ceiling
+void ofApp::checkLimit(const string & what, const string & unit, const size_t count, const size_t limit, const size_t ceiling)
+{
+    if (count > ceiling) {
+        fail(what + " allocated " + ofToString(count) + " " + unit + ", the ceiling is " + ofToString(ceiling));
+    }
+    else if (cycle > 0 && count > limit + limit * settings.allocationSlack / 100 + SOAK_LIMIT_SLACK) {
+        fail(what + " allocated " + ofToString(count) + " " + unit + ", at most " + ofToString(limit) + " in the first cycle");
+    }
+}
+
+void ofApp::fail(const string & message)
+{
+    ofLogError("exampleSoak") << message;
+    numFailures++;
+}
+
+void ofApp::finish()
+{
+    saliencyMap.setPipelineEnabled(false);
+    csv.close();
+
+    float elapsed = ofGetElapsedTimef() - startTime;
+    ofLogNotice("exampleSoak") << totalFrames << " frames in " << elapsed << " s: "
+                               << totalFrames / MAX(elapsed, 0.001f) << " frames/s, at most "
+                               << maxAllocations << " matrices and " << maxHeapAllocations << " heap blocks per frame";
+    if (numFailures > 0) ofLogError("exampleSoak") << numFailures << " failures";
+    else ofLogNotice("exampleSoak") << "passed";
+
+    ofExit(numFailures > 0 ? 1 : 0);
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "ofMain.h"
+#include "ofxSaliencyMap.h"
+
+// command line settings, see printUsage() in main.cpp
+struct SoakSettings {
+
+    SoakSettings();
+
+    int cycles;		// passes over all phases
+    int frames;		// frames per phase
+    int maxAllocations;	// ceiling of matrices allocated by one frame (or one query), on every release
+    int maxHeapAllocations;	// the same for heap blocks
+    int allocationSlack;	// percent a frame may allocate over the highest count of its phase in the first cycle
+    float rssTolerance;	// MB the resident size may grow over the end of the first cycle
+    int rssTrend;	// cycle ends in a row the resident size may grow
+    string csv;		// per-frame log, empty for none
+
+};
+
+// allocations of one frame
+struct SoakAllocations {
+
+    SoakAllocations();
+
+    size_t frameMats;	// matrices created by createSaliencyMap()
+    size_t frameHeap;	// heap blocks allocated by it, see HeapCounter.h
+    size_t queryMats;	// the same for querySaliency()
+    size_t queryHeap;
+
+};
+
+// one configuration driven for SoakSettings::frames frames
+struct SoakPhase {
+
+    string name;
+    int width;
+    int height;
+    bool pipeline;
+    bool lowMemory;
+    bool query;	// querySaliency() after every frame
+
+    // highest allocations of the first cycle, of frames 0-1 (new resolution, no motion
+    // pair yet) and of the rest. later cycles must stay within them plus the slack, and
+    // every frame within the fixed ceilings of SoakSettings
+    SoakAllocations limits[2];
+
+};
+
+// headless long-run check of ofxSaliencyMap: drives every phase with a moving synthetic
+// scene (resolution changes, motion, pipelined, low-memory and query frames), one frame
+// per update(), and fails on matrix or resident memory growth between cycles and on
+// frames allocating more matrices or heap blocks than the fixed ceilings, or than in the
+// first cycle
+class ofApp : public ofBaseApp{
+
+public:
+    ofApp(const SoakSettings & settings);
+
+    void setup();
+    void update();
+    void exit();
+
+private:
+    void renderFrame();
+    void checkFrame(SoakPhase & current, const SoakAllocations & allocations);
+    void checkLimit(const string & what, const string & unit, const size_t count, const size_t limit, const size_t ceiling);
+    void checkCycle();
+    void fail(const string & message);
+    void finish();
+
+    SoakSettings settings;
+    vector<SoakPhase> phases;
+
+    ofxSaliencyMap saliencyMap;
+    ofPixels pixels;
+    ofFile csv;
+
+    int cycle;
+    size_t phase;
+    int frame;
+    int totalFrames;
+    int numFailures;
+    size_t phaseLiveMats;	// after the second frame of a phase
+    size_t maxAllocations;
+    size_t maxHeapAllocations;
+
+    // end of the first cycle
+    bool bBaseline;
+    size_t baselineLiveMats;
+    size_t baselineBytes;
+    size_t baselineResident;
+    size_t lastResident;
+    int residentGrowth;	// cycle ends in a row with a higher resident size
+
+    float startTime;
+};
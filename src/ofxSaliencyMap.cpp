@@ -7,171 +7,1287 @@
  http://opensource.org/licenses/mit-license.php
  */
 #include "ofxSaliencyMap.h"
+#include "ofxSaliencyMapFeatures.h"
 
 using namespace ofxCv;
 using namespace cv;
 
-void FMGaussianPyrCSD(CvMat* src, CvMat* dst[6]);
-void FMCreateGaussianPyr(CvMat* src, CvMat* dst[9]);
-void FMCenterSurroundDiff(CvMat* GaussianMap[9], CvMat* dst[6]);
+template<class Scales> void FMCreateGaussianPyr(CvMat* src, CvMat* dst[Scales::LEVELS]);
+void FMCenterSurroundPair(CvMat* center, CvMat* surround, CvMat* dst, const ofxSaliencyMapLinearTable & tx, const ofxSaliencyMapLinearTable & ty);
 double SMAvgLocalMax(CvMat* src);
+CvMat* SMRangeNormalizeWith(CvMat* src, double minn, double maxx);
+CvRect SMQueryWindow(const ofRectangle & region, CvSize size, int align);
+void SMMergeQueryWindows(vector<CvRect> & windows, vector<int> & windowOf);
+void SMOutputPlane(CvMat* plane, ofPixels & pix);
+void SMOutputFloat(CvMat* plane, ofFloatPixels & pix);
+void SMPlanNodeUse(vector<ofxSaliencyMapNodeData> & nodes, int index, int step, vector<bool> & produced);
 
 ofxSaliencyMap::ofxSaliencyMap()
 {
-    prev_frame = 0;
-    GaborKernel0 = 0;
-    GaborKernel45 = 0;
-    GaborKernel90 = 0;
-    GaborKernel135 = 0;
+    mSourceSerial = 0;
+    mQueryNorm = OFXSALIENCYMAP_QUERY_NORM_CACHED;
+    mOrientationMode = OFXSALIENCYMAP_ORIENTATION_DENSE;
+    mScaleSet = OFXSALIENCYMAP_SCALES_AUTO;
+    mNormCacheScales = OFXSALIENCYMAP_SCALES_DEFAULT;
+    mNormCacheRevision = 0;
+    mGraphRevision = 0;
+    bPipeline = false;
+    bLowMemory = false;
+    bFloatOutput = false;
+    bStopTasks = false;
+    mPeakWorkingSetBytes = 0;
+    mFrameAllocations = 0;
+    mQueryPixels = 0;
+    
+    // single-threaded unless the caller opts in: one instance per stream must not oversubscribe the CPU
+    mNumThreads = 0;
+    
+    mChannels.push_back(&mIntensityChannel);
+    mChannels.push_back(&mColorChannel);
+    mChannels.push_back(&mOrientationChannel);
+    mChannels.push_back(&mMotionChannel);
+    addNode(&mRGBINode);
+    addNode(&mIntensityPyramidNode);
+    addNode(&mOpponencyNode);
+    addNode(&mMotionNode);
     initParams();
 }
 
 ofxSaliencyMap::~ofxSaliencyMap()
 {
-    cvReleaseMat(&prev_frame);
-    cvReleaseMat(&GaborKernel0);
-    cvReleaseMat(&GaborKernel45);
-    cvReleaseMat(&GaborKernel90);
-    cvReleaseMat(&GaborKernel135);
+    // drop the frame still in flight
+    if (bPipeline) {
+        FeatureFrame * done = mPipelineWorker.exchange(NULL);
+        if (done != NULL) {
+            releaseFrame(done);
+            delete done;
+        }
+        mPipelineWorker.stop();
+    }
+    stopTaskWorkers();
+}
+
+void ofxSaliencyMap::createSaliencyMap()
+{
+    // check source image
+    if (!mSrcImg.isAllocated()) {
+        cout << "[ERROR] do not read source image" << endl;
+        return;
+    }
+    
+    // init gabor kernels
+    initGabor();
+    
+    //----------
+    // Intensity and RGB Extraction, Frame Graph Nodes
+    //----------
+    
+    IplImage src = toCv(mSrcImg);
+    CvMat srcHeader;
+    CvMat * srcMat = cvGetMat(&src, &srcHeader);
+    
+    ofxSaliencyMapScaleSet scales = resolveScaleSet(cvSize(srcMat->cols, srcMat->rows));
+    if (MIN(srcMat->cols, srcMat->rows) < SMScaleInfo(scales).minSize) {
+        cout << "[ERROR] source image is too small for the pyramid depth" << endl;
+        return;
+    }
+    
+    // a low-memory frame is never pipelined: deliver a frame still in flight first
+    if (bLowMemory) flushPipeline();
+    bool pipelined = bPipeline && !bLowMemory;
+    
+    // the frame's matrices are counted in its own scope, on every thread that works on it. a
+    // pipelined frame finishes after this call returns, so it does not charge the caller's scope
+    updatePlan();
+    FeatureFrame * frame = new FeatureFrame();
+    frame->memory.setParent(pipelined ? NULL : SMGetMemoryScope());
+    {
+        
+        ofxSaliencyMapMemoryBinding binding(&frame->memory);
+        advanceNodes(srcMat);
+        buildFrame(frame, srcMat, cvRect(0, 0, srcMat->cols, srcMat->rows), scales);
+        frame->pipelined = pipelined;
+        produceNodes(frame);
+        outputPlanes(frame);
+        releaseNodes(frame, -1);
+        
+        // the feature extraction of the channels (Gabor filters, optical flow, center-surround)
+        // stays on this thread; the worker normalizes, blends and outputs
+        if (pipelined) extractChannels(frame);
+        
+    }
+    
+    //----------
+    // Conspicuity Maps and Saliency Map
+    //----------
+    
+    if (pipelined) {
+        
+        // hand this frame over and take back the previous one
+        FeatureFrame * done = mPipelineWorker.exchange(frame);
+        if (done != NULL) {
+            publishFrame(done);
+            delete done;
+        }
+        
+    } else {
+        
+        {
+            
+            ofxSaliencyMapMemoryBinding binding(&frame->memory);
+            combineFeatures(frame);
+            outputFrame(frame);
+            
+        }
+        publishFrame(frame);
+        delete frame;
+        
+    }
+    
+}
+
+void ofxSaliencyMap::setPipelineEnabled(const bool enable)
+{
+    if (enable == bPipeline) return;
+    
+    if (enable) {
+        mPipelineWorker.setup(this);
+        mPipelineWorker.startThread(true, false);
+    } else {
+        flushPipeline();
+        mPipelineWorker.stop();
+    }
+    bPipeline = enable;
+}
+
+void ofxSaliencyMap::flushPipeline()
+{
+    if (!bPipeline) return;
+    
+    FeatureFrame * done = mPipelineWorker.exchange(NULL);
+    if (done != NULL) {
+        publishFrame(done);
+        delete done;
+    }
+}
+
+void ofxSaliencyMap::buildFrame(FeatureFrame * frame, CvMat * src, CvRect window, ofxSaliencyMapScaleSet scales)
+{
+    
+    cvGetSubRect(src, &frame->source, window);
+    frame->window = window;
+    frame->size = cvSize(window.width, window.height);
+    frame->scales = scales;
+    frame->surroundTables = getSurroundTables(frame->size, scales);
+    frame->revision = mGraphRevision;
+    frame->lowMemory = bLowMemory;
+    frame->floatOutput = bFloatOutput;
+    
+    // channels and weights are captured here so that a pipelined frame is blended with the values set when it was submitted
+    frame->channels = mPlan.channels;
+    frame->channelInputs = mPlan.channelInputs;
+    frame->weights.clear();
+    for (int i=0; i<frame->channels.size(); i++) frame->weights.push_back(frame->channels[i]->getWeight());
+    frame->CM.assign(frame->channels.size(), (CvMat *)NULL);
+    if (frame->floatOutput) frame->pixCM.resize(frame->channels.size());
+    frame->traces.resize(frame->channels.size() + 1);
+    
+    // one entry per node of the plan; the outputs of each are kept up to the last channel reading them
+    frame->rgbi = mPlan.rgbi;
+    frame->nodes.assign(mPlan.nodes.size(), ofxSaliencyMapNodeData());
+    for (int i=0; i<mPlan.nodes.size(); i++)
+    {
+        
+        ofxSaliencyMapNodeData & data = frame->nodes[i];
+        data.node = mPlan.nodes[i];
+        data.dependencies = mPlan.dependencies[i];
+        for (int d=0; d<data.dependencies.size(); d++) frame->nodes[data.dependencies[d]].dependents.push_back(i);
+        
+    }
+    
+    // a low-memory frame produces each node right before the first channel that needs it, so
+    // a node is also used by the channel its dependents are produced for. the RGBI planes go
+    // to the output planes before any channel runs
+    vector<bool> produced(frame->nodes.size(), !frame->lowMemory);
+    if (frame->rgbi >= 0) SMPlanNodeUse(frame->nodes, frame->rgbi, -1, produced);
+    for (int c=0; c<frame->channelInputs.size(); c++)
+    {
+        
+        for (int k=0; k<frame->channelInputs[c].size(); k++)
+        {
+            
+            int index = frame->channelInputs[c][k];
+            SMPlanNodeUse(frame->nodes, index, c, produced);
+            frame->nodes[index].lastUse = c;
+            
+        }
+        
+    }
+    
+}
+
+void SMPlanNodeUse(vector<ofxSaliencyMapNodeData> & nodes, int index, int step, vector<bool> & produced)
+{
+    
+    if (produced[index]) return;
+    const vector<int> & dependencies = nodes[index].dependencies;
+    for (int d=0; d<dependencies.size(); d++)
+    {
+        
+        SMPlanNodeUse(nodes, dependencies[d], step, produced);
+        nodes[dependencies[d]].lastUse = MAX(nodes[dependencies[d]].lastUse, step);
+        
+    }
+    produced[index] = true;
+    
+}
+
+void ofxSaliencyMap::produceNodes(FeatureFrame * frame)
+{
+    
+    // low-memory frames produce their nodes on demand (see runChannels())
+    if (frame->lowMemory) return;
+    
+    // each node is produced once, however many channels and nodes read it
+    int num = frame->nodes.size();
+    if (mNumThreads <= 0 || num < 2)
+    {
+        
+        // the plan is in dependency order
+        for (int i=0; i<num; i++) produceNode(frame, i);
+        return;
+        
+    }
+    
+    // nodes without dependencies first; runTask() queues each dependent once its last dependency is done
+    vector<Task> ready;
+    for (int i=0; i<num; i++)
+    {
+        
+        frame->nodes[i].pendingDependencies = frame->nodes[i].dependencies.size();
+        if (frame->nodes[i].pendingDependencies > 0) continue;
+        Task task;
+        task.frame = frame;
+        task.node = i;
+        task.channel = -1;
+        ready.push_back(task);
+        
+    }
+    runTasks(frame, ready, num);
+    
+}
+
+void ofxSaliencyMap::produceNode(FeatureFrame * frame, int index)
+{
+    
+    ofxSaliencyMapNodeData & data = frame->nodes[index];
+    ofxSaliencyMapNodeContext context(frame->nodes, &frame->source, frame->window, frame->scales, data.outputs);
+    data.node->produce(context);
+    data.produced = true;
+    
+}
+
+void ofxSaliencyMap::requireNode(FeatureFrame * frame, int index)
+{
+    
+    ofxSaliencyMapNodeData & data = frame->nodes[index];
+    if (data.produced) return;
+    for (int d=0; d<data.dependencies.size(); d++) requireNode(frame, data.dependencies[d]);
+    produceNode(frame, index);
+    
+}
+
+void ofxSaliencyMap::releaseNodes(FeatureFrame * frame, int after)
+{
+    
+    for (int i=0; i<frame->nodes.size(); i++)
+    {
+        
+        ofxSaliencyMapNodeData & data = frame->nodes[i];
+        if (data.lastUse > after) continue;
+        for (int j=0; j<data.outputs.size(); j++) SMReleaseMat(&data.outputs[j]);
+        data.outputs.clear();
+        
+    }
+    
+}
+
+void ofxSaliencyMap::advanceNodes(CvMat * src)
+{
+    
+    // the same source image always yields the same node state, however often it is processed.
+    // only the nodes of the plan see the image: a node no channel reads (the motion node once
+    // the motion channel is removed) costs nothing, and resumes from its last image if it is read again
+    for (int i=0; i<mPlan.nodes.size(); i++)
+    {
+        
+        int index = find(mNodes.begin(), mNodes.end(), mPlan.nodes[i]) - mNodes.begin();
+        if (mNodeSerials[index] == mSourceSerial) continue;
+        mPlan.nodes[i]->advance(src);
+        mNodeSerials[index] = mSourceSerial;
+        
+    }
+    
+}
+
+void ofxSaliencyMap::combineFeatures(FeatureFrame * frame)
+{
+    
+    //----------
+    // Generate Conspicuity Maps, and add them up to form Saliency Map
+    //----------
+    
+    runChannels(frame);
+    if (frame->SM == NULL)
+    {
+        
+        // no channel registered
+        frame->SM = SMCreateMat(frame->size.height, frame->size.width, CV_32FC1);
+        cvSetZero(frame->SM);
+        
+    }
+    CvMat* SM_Mat = frame->SM;
+    frame->SM = SMRangeNormalize(SM_Mat, &frame->traces.back());
+    SMReleaseMat(&SM_Mat);
+    releaseNodes(frame, frame->channels.size());
+    
+}
+
+void ofxSaliencyMap::extractChannels(FeatureFrame * frame)
+{
+    
+    int num = frame->channels.size();
+    if (mNumThreads <= 0 || num < 2)
+    {
+        
+        for (int i=0; i<num; i++)
+        {
+            
+            runChannel(frame, i);
+            releaseNodes(frame, i);
+            
+        }
+        
+    } else {
+        
+        vector<Task> ready;
+        for (int i=0; i<num; i++)
+        {
+            
+            Task task;
+            task.frame = frame;
+            task.node = -1;
+            task.channel = i;
+            ready.push_back(task);
+            
+        }
+        runTasks(frame, ready, num);
+        releaseNodes(frame, num);
+        
+    }
+    
+}
+
+void ofxSaliencyMap::runChannels(FeatureFrame * frame)
+{
+    
+    int num = frame->channels.size();
+    if (frame->pipelined)
+    {
+        
+        // the caller made the conspicuity maps (see extractChannels())
+        for (int i=0; i<num; i++) blendChannel(frame, i);
+        return;
+        
+    }
+    if (frame->lowMemory || mNumThreads <= 0 || num < 2)
+    {
+        
+        // one channel after another: each conspicuity map is blended right away, and
+        // each node is released after the last channel that reads it
+        for (int i=0; i<num; i++)
+        {
+            
+            for (int k=0; k<frame->channelInputs[i].size(); k++) requireNode(frame, frame->channelInputs[i][k]);
+            runChannel(frame, i);
+            blendChannel(frame, i);
+            releaseNodes(frame, i);
+            
+        }
+        return;
+        
+    }
+    
+    vector<Task> ready;
+    for (int i=0; i<num; i++)
+    {
+        
+        Task task;
+        task.frame = frame;
+        task.node = -1;
+        task.channel = i;
+        ready.push_back(task);
+        
+    }
+    runTasks(frame, ready, num);
+    
+    // blend in registration order, so that the result does not depend on the thread timing
+    for (int i=0; i<num; i++) blendChannel(frame, i);
+    
+}
+
+void ofxSaliencyMap::runTasks(FeatureFrame * frame, const vector<Task> & ready, int total)
+{
+    
+    // queue the tasks, and work on the queue until all of this frame are done
+    startTaskWorkers();
+    mTaskMutex.lock();
+    frame->pendingTasks = total;
+    for (int i=0; i<ready.size(); i++) mTasks.push_back(ready[i]);
+    mTaskCondition.broadcast();
+    while (frame->pendingTasks > 0)
+    {
+        
+        if (mTasks.empty()) {
+            mTaskCondition.wait(mTaskMutex);
+        } else {
+            mTaskMutex.unlock();
+            runTask(false);
+            mTaskMutex.lock();
+        }
+        
+    }
+    mTaskMutex.unlock();
+    
+}
+
+void ofxSaliencyMap::runChannel(FeatureFrame * frame, int index)
+{
+    
+    NormTrace * trace = &frame->traces[index];
+    ofxSaliencyMapChannelContext context(this, frame->nodes, frame->size, frame->scales, frame->surroundTables.get(), trace);
+    CvMat * CM = frame->channels[index]->createConspicuityMap(context);
+    if (CM == NULL) return;
+    
+    if (CM->cols != frame->size.width || CM->rows != frame->size.height || CV_MAT_TYPE(CM->type) != CV_32FC1) {
+        cout << "[ERROR] channel \"" << frame->channels[index]->getName() << "\" returned a map of wrong size or type" << endl;
+        SMReleaseMat(&CM);
+        return;
+    }
+    
+    // Normalize conspicuity map (a pipelined frame on the worker, in blendChannel())
+    if (frame->pipelined) {
+        frame->CM[index] = CM;
+        return;
+    }
+    frame->CM[index] = SMNormalization(CM, trace);
+    SMReleaseMat(&CM);
+    
+}
+
+void ofxSaliencyMap::blendChannel(FeatureFrame * frame, int index)
+{
+    
+    if (frame->SM == NULL)
+    {
+        
+        frame->SM = SMCreateMat(frame->size.height, frame->size.width, CV_32FC1);
+        cvSetZero(frame->SM);
+        
+    }
+    if (frame->CM[index] == NULL) return;
+    if (frame->pipelined)
+    {
+        
+        CvMat * CM = frame->CM[index];
+        frame->CM[index] = SMNormalization(CM, &frame->traces[index]);
+        SMReleaseMat(&CM);
+        
+    }
+    if (frame->floatOutput) SMOutputFloat(frame->CM[index], frame->pixCM[index]);
+    
+    // add it to Saliency Map
+    cvAddWeighted(frame->CM[index], frame->weights[index], frame->SM, 1.00, 0.0, frame->SM);
+    SMReleaseMat(&frame->CM[index]);
+    
+}
+
+template<class Scales>
+void ofxSaliencyMap::streamCSD(CvMat* const pyramid[], CvMat* accum, const SurroundTables * tables, NormTrace * trace)
+{
+    
+    // a pyramid of another geometry than the frame's (a channel's own map) gets tables for this call only
+    SurroundTables * local = NULL;
+    if (tables == NULL || !tables->matches(pyramid))
+    {
+        
+        local = new SurroundTables();
+        local->setup(pyramid, Scales::info());
+        tables = local;
+        
+    }
+    
+    // one center-surround map at a time: difference, normalize, upsample, accumulate, release
+    CvMat* upsampled = SMCreateMat(accum->height, accum->width, CV_32FC1);
+    for(int s=Scales::CENTER_BEGIN; s<Scales::CENTER_END; s++)
+    {
+        
+        for(int d=0; d<2; d++)
+        {
+            
+            int m = (s - Scales::CENTER_BEGIN) * 2 + d;
+            CvMat* FM = SMCreateMat(pyramid[s]->height, pyramid[s]->width, CV_32FC1);
+            FMCenterSurroundPair(pyramid[s], pyramid[s + (d == 0 ? Scales::DELTA0 : Scales::DELTA1)], FM, tables->x[m], tables->y[m]);
+            CvMat* NFM = SMNormalization(FM, trace);
+            SMReleaseMat(&FM);
+            cvResize(NFM, upsampled, CV_INTER_LINEAR);
+            SMReleaseMat(&NFM);
+            cvAdd(accum, upsampled, accum);
+            
+        }
+        
+    }
+    SMReleaseMat(&upsampled);
+    delete local;
+    
+}
+
+void ofxSaliencyMap::addConspicuity(CvMat * src, CvMat * accum, ofxSaliencyMapScaleSet scales, const SurroundTables * tables, NormTrace * trace)
+{
+    
+    // every scale set is its own instantiation, so the pyramid loops have constant bounds
+    switch (scales) {
+        case OFXSALIENCYMAP_SCALES_VGA: addConspicuity<ofxSaliencyMapScalesVGA>(src, accum, tables, trace); break;
+        case OFXSALIENCYMAP_SCALES_QVGA: addConspicuity<ofxSaliencyMapScalesQVGA>(src, accum, tables, trace); break;
+        case OFXSALIENCYMAP_SCALES_QQVGA: addConspicuity<ofxSaliencyMapScalesQQVGA>(src, accum, tables, trace); break;
+        default: addConspicuity<ofxSaliencyMapScalesDefault>(src, accum, tables, trace); break;
+    }
+    
+}
+
+template<class Scales>
+void ofxSaliencyMap::addConspicuity(CvMat * src, CvMat * accum, const SurroundTables * tables, NormTrace * trace)
+{
+    
+    CvMat* pyramid[Scales::LEVELS];
+    FMCreateGaussianPyr<Scales>(src, pyramid);
+    streamCSD<Scales>(pyramid, accum, tables, trace);
+    for(int j=0; j<Scales::LEVELS; j++) SMReleaseMat(&pyramid[j]);
+    
+}
+
+void ofxSaliencyMap::addConspicuityFromPyramid(CvMat * const pyramid[], CvMat * accum, ofxSaliencyMapScaleSet scales, const SurroundTables * tables, NormTrace * trace)
+{
+    
+    switch (scales) {
+        case OFXSALIENCYMAP_SCALES_VGA: streamCSD<ofxSaliencyMapScalesVGA>(pyramid, accum, tables, trace); break;
+        case OFXSALIENCYMAP_SCALES_QVGA: streamCSD<ofxSaliencyMapScalesQVGA>(pyramid, accum, tables, trace); break;
+        case OFXSALIENCYMAP_SCALES_QQVGA: streamCSD<ofxSaliencyMapScalesQQVGA>(pyramid, accum, tables, trace); break;
+        default: streamCSD<ofxSaliencyMapScalesDefault>(pyramid, accum, tables, trace); break;
+    }
+    
+}
+
+void ofxSaliencyMap::outputPlanes(FeatureFrame * frame)
+{
+    
+    // output RGB and I images
+    if (frame->rgbi < 0) return;
+    requireNode(frame, frame->rgbi);
+    const vector<CvMat *> & planes = frame->nodes[frame->rgbi].outputs;
+    if (planes.size() < 4) return;
+    SMOutputPlane(planes[0], frame->pixR);
+    SMOutputPlane(planes[1], frame->pixG);
+    SMOutputPlane(planes[2], frame->pixB);
+    SMOutputPlane(planes[3], frame->pixI);
+    
+}
+
+void ofxSaliencyMap::outputFrame(FeatureFrame * frame)
+{
+    
+    // Output Result Map
+    SMOutputPlane(frame->SM, frame->pixDst);
+    if (frame->floatOutput) SMOutputFloat(frame->SM, frame->pixDstFloat);
+    
+    releaseFrame(frame);
+    
+}
+
+void SMOutputPlane(CvMat* plane, ofPixels & pix)
+{
+    
+    CvMat *tmp = SMCreateMat(plane->height, plane->width, CV_8UC1);
+    cvConvertScaleAbs(plane, tmp, 255);
+    pix.setFromPixels((unsigned char *)tmp->data.ptr, tmp->cols, tmp->rows, OF_IMAGE_GRAYSCALE);
+    SMReleaseMat(&tmp);
+    
+}
+
+void SMOutputFloat(CvMat* plane, ofFloatPixels & pix)
+{
+    
+    pix.allocate(plane->cols, plane->rows, OF_IMAGE_GRAYSCALE);
+    for (int y=0; y<plane->rows; y++)
+    {
+        
+        memcpy(pix.getPixels() + y * plane->cols, plane->data.ptr + y * plane->step, sizeof(float) * plane->cols);
+        
+    }
+    
+}
+
+void ofxSaliencyMap::publishFrame(FeatureFrame * frame)
+{
+    // ofImage uploads textures, so this stays on the caller thread
+    if (frame->pixR.isAllocated()) {
+        mR.setFromPixels(frame->pixR);
+        mG.setFromPixels(frame->pixG);
+        mB.setFromPixels(frame->pixB);
+        mI.setFromPixels(frame->pixI);
+    }
+    mDstImg.setFromPixels(frame->pixDst);
+    
+    mDstFloat.swap(frame->pixDstFloat);
+    mConspicuity.swap(frame->pixCM);
+    mConspicuityNames.clear();
+    for (int i=0; i<mConspicuity.size(); i++) mConspicuityNames.push_back(frame->channels[i]->getName());
+    
+    ofxSaliencyMapMemoryStats memory = frame->memory.getStats();
+    mPeakWorkingSetBytes = memory.peakBytes;
+    mFrameAllocations = memory.allocations;
+    
+    // keep the statistics of the newest full frame for sparse queries
+    mNormCache.swap(frame->traces);
+    mNormCacheScales = frame->scales;
+    mNormCacheRevision = frame->revision;
+}
+
+void ofxSaliencyMap::releaseFrame(FeatureFrame * frame)
+{
+    releaseNodes(frame, frame->channels.size());
+    for(int i=0; i<frame->CM.size(); i++) SMReleaseMat(&frame->CM[i]);
+    SMReleaseMat(&frame->SM);
+}
+
+ofxSaliencyMap::FeatureFrame::FeatureFrame()
+{
+    size = cvSize(0, 0);
+    scales = OFXSALIENCYMAP_SCALES_DEFAULT;
+    revision = 0;
+    lowMemory = false;
+    floatOutput = false;
+    pipelined = false;
+    window = cvRect(0, 0, 0, 0);
+    rgbi = -1;
+    pendingTasks = 0;
+    SM = NULL;
+}
+
+ofxSaliencyMap::GraphPlan::GraphPlan()
+{
+    valid = false;
+    revision = 0;
+    rgbi = -1;
+}
+
+//////////////////////////////////////////////////////////////////
+// Pipeline Worker
+//////////////////////////////////////////////////////////////////
+ofxSaliencyMap::PipelineWorker::PipelineWorker()
+{
+    owner = NULL;
+    pending = NULL;
+    finished = NULL;
+    busy = false;
+}
+
+void ofxSaliencyMap::PipelineWorker::setup(ofxSaliencyMap * owner)
+{
+    this->owner = owner;
+}
+
+ofxSaliencyMap::FeatureFrame * ofxSaliencyMap::PipelineWorker::exchange(FeatureFrame * next)
+{
+    lock();
+    while (busy) condition.wait(mutex);
+    FeatureFrame * done = finished;
+    finished = NULL;
+    if (next != NULL) {
+        pending = next;
+        busy = true;
+        condition.broadcast();
+    }
+    unlock();
+    return done;
+}
+
+void ofxSaliencyMap::PipelineWorker::stop()
+{
+    if (!isThreadRunning()) return;
+    
+    lock();
+    stopThread();
+    condition.broadcast();
+    unlock();
+    waitForThread(false);
+}
+
+void ofxSaliencyMap::PipelineWorker::threadedFunction()
+{
+    while (isThreadRunning()) {
+        
+        lock();
+        while (pending == NULL && isThreadRunning()) condition.wait(mutex);
+        FeatureFrame * job = pending;
+        pending = NULL;
+        unlock();
+        if (job == NULL) break;
+        
+        {
+            
+            ofxSaliencyMapMemoryBinding binding(&job->memory);
+            owner->combineFeatures(job);
+            owner->outputFrame(job);
+            
+        }
+        
+        lock();
+        finished = job;
+        busy = false;
+        condition.broadcast();
+        unlock();
+        
+    }
+}
+
+//////////////////////////////////////////////////////////////////
+// Channel Scheduler
+//////////////////////////////////////////////////////////////////
+void ofxSaliencyMap::addChannel(ofxSaliencyMapChannel * channel)
+{
+    if (channel == NULL || find(mChannels.begin(), mChannels.end(), channel) != mChannels.end()) return;
+    
+    // a pipelined frame still runs the current graph
+    flushPipeline();
+    mChannels.push_back(channel);
+    mGraphRevision++;
+}
+
+void ofxSaliencyMap::removeChannel(ofxSaliencyMapChannel * channel)
+{
+    vector<ofxSaliencyMapChannel *>::iterator it = find(mChannels.begin(), mChannels.end(), channel);
+    if (it == mChannels.end()) return;
+    
+    flushPipeline();
+    mChannels.erase(it);
+    mGraphRevision++;
+}
+
+ofxSaliencyMapChannel * ofxSaliencyMap::getChannel(const string & name)
+{
+    for (int i=0; i<mChannels.size(); i++) {
+        if (mChannels[i]->getName() == name) return mChannels[i];
+    }
+    return NULL;
+}
+
+void ofxSaliencyMap::addNode(ofxSaliencyMapNode * node)
+{
+    if (node == NULL || find(mNodes.begin(), mNodes.end(), node) != mNodes.end()) return;
+    
+    flushPipeline();
+    removeNode(getNode(node->getName()));
+    mNodes.push_back(node);
+    mNodeSerials.push_back(0);
+    mGraphRevision++;
+}
+
+void ofxSaliencyMap::removeNode(ofxSaliencyMapNode * node)
+{
+    vector<ofxSaliencyMapNode *>::iterator it = find(mNodes.begin(), mNodes.end(), node);
+    if (it == mNodes.end()) return;
+    
+    flushPipeline();
+    mNodeSerials.erase(mNodeSerials.begin() + (it - mNodes.begin()));
+    mNodes.erase(it);
+    mGraphRevision++;
+}
+
+ofxSaliencyMapNode * ofxSaliencyMap::getNode(const string & name)
+{
+    for (int i=0; i<mNodes.size(); i++) {
+        if (mNodes[i]->getName() == name) return mNodes[i];
+    }
+    return NULL;
+}
+
+void ofxSaliencyMap::updatePlan()
+{
+    
+    if (mPlan.valid && mPlan.revision == mGraphRevision) return;
+    mPlan = GraphPlan();
+    mPlan.valid = true;
+    mPlan.revision = mGraphRevision;
+    
+    // the nodes each channel reads, depth first; a channel that cannot be resolved is reported
+    // once per graph revision, and the nodes planned for it alone are dropped again
+    for (int c=0; c<mChannels.size(); c++)
+    {
+        
+        const vector<string> & inputs = mChannels[c]->getInputs();
+        int planned = mPlan.nodes.size();
+        vector<string> path;
+        string error;
+        bool resolved = true;
+        for (int k=0; k<inputs.size() && resolved; k++) resolved = planNode(inputs[k], path, error);
+        if (!resolved)
+        {
+            
+            cout << "[ERROR] channel \"" << mChannels[c]->getName() << "\" is skipped: " << error << endl;
+            mPlan.nodes.resize(planned);
+            continue;
+            
+        }
+        mPlan.channels.push_back(mChannels[c]);
+        
+    }
+    
+    // the output planes come from the RGBI node whenever there is one
+    string error;
+    vector<string> path;
+    if (getNode(OFXSALIENCYMAP_NODE_RGBI) != NULL && planNode(OFXSALIENCYMAP_NODE_RGBI, path, error))
+    {
+        
+        for (int i=0; i<mPlan.nodes.size(); i++) if (mPlan.nodes[i]->getName() == OFXSALIENCYMAP_NODE_RGBI) mPlan.rgbi = i;
+        
+    }
+    
+    // names to indices
+    map<string, int> index;
+    for (int i=0; i<mPlan.nodes.size(); i++) index[mPlan.nodes[i]->getName()] = i;
+    mPlan.dependencies.resize(mPlan.nodes.size());
+    for (int i=0; i<mPlan.nodes.size(); i++)
+    {
+        
+        const vector<string> & dependencies = mPlan.nodes[i]->getDependencies();
+        for (int d=0; d<dependencies.size(); d++) mPlan.dependencies[i].push_back(index[dependencies[d]]);
+        
+    }
+    mPlan.channelInputs.resize(mPlan.channels.size());
+    for (int c=0; c<mPlan.channels.size(); c++)
+    {
+        
+        const vector<string> & inputs = mPlan.channels[c]->getInputs();
+        for (int k=0; k<inputs.size(); k++) mPlan.channelInputs[c].push_back(index[inputs[k]]);
+        
+    }
+    
+}
+
+bool ofxSaliencyMap::planNode(const string & name, vector<string> & path, string & error)
+{
+    
+    for (int i=0; i<mPlan.nodes.size(); i++) if (mPlan.nodes[i]->getName() == name) return true;
+    if (find(path.begin(), path.end(), name) != path.end())
+    {
+        
+        error = "node \"" + name + "\" depends on itself";
+        return false;
+        
+    }
+    ofxSaliencyMapNode * node = getNode(name);
+    if (node == NULL)
+    {
+        
+        error = "unknown node \"" + name + "\"";
+        return false;
+        
+    }
+    
+    // dependencies first, so that the plan is in dependency order
+    path.push_back(name);
+    const vector<string> & dependencies = node->getDependencies();
+    for (int d=0; d<dependencies.size(); d++)
+    {
+        
+        if (!planNode(dependencies[d], path, error)) return false;
+        
+    }
+    path.pop_back();
+    mPlan.nodes.push_back(node);
+    return true;
+    
+}
+
+void ofxSaliencyMap::setNumThreads(const int num)
+{
+    if (MAX(0, num) == mNumThreads) return;
+    
+    // no frame may be in flight while the scheduler threads change
+    flushPipeline();
+    stopTaskWorkers();
+    mNumThreads = MAX(0, num);
+}
+
+bool ofxSaliencyMap::runTask(bool wait)
+{
+    
+    mTaskMutex.lock();
+    while (wait && mTasks.empty() && !bStopTasks) mTaskCondition.wait(mTaskMutex);
+    if (mTasks.empty())
+    {
+        
+        bool running = !bStopTasks;
+        mTaskMutex.unlock();
+        return running;
+        
+    }
+    Task task = mTasks.front();
+    mTasks.pop_front();
+    mTaskMutex.unlock();
+    
+    {
+        
+        ofxSaliencyMapMemoryBinding binding(&task.frame->memory);
+        if (task.node >= 0) produceNode(task.frame, task.node);
+        else runChannel(task.frame, task.channel);
+        
+    }
+    
+    mTaskMutex.lock();
+    if (task.node >= 0)
+    {
+        
+        // the nodes waiting for this one only
+        const vector<int> & dependents = task.frame->nodes[task.node].dependents;
+        for (int i=0; i<dependents.size(); i++)
+        {
+            
+            if (--task.frame->nodes[dependents[i]].pendingDependencies > 0) continue;
+            Task next;
+            next.frame = task.frame;
+            next.node = dependents[i];
+            next.channel = -1;
+            mTasks.push_back(next);
+            
+        }
+        
+    }
+    task.frame->pendingTasks--;
+    mTaskCondition.broadcast();
+    mTaskMutex.unlock();
+    return true;
+    
 }
 
-void ofxSaliencyMap::createSaliencyMap()
+void ofxSaliencyMap::startTaskWorkers()
+{
+    // started on first use, from whichever thread runs the first frame
+    mTaskMutex.lock();
+    if (mTaskWorkers.empty()) {
+        bStopTasks = false;
+        for (int i=0; i<mNumThreads; i++) {
+            TaskWorker * worker = new TaskWorker();
+            worker->setup(this);
+            worker->startThread(true, false);
+            mTaskWorkers.push_back(worker);
+        }
+    }
+    mTaskMutex.unlock();
+}
+
+void ofxSaliencyMap::stopTaskWorkers()
+{
+    mTaskMutex.lock();
+    bStopTasks = true;
+    for (int i=0; i<mTaskWorkers.size(); i++) mTaskWorkers[i]->stopThread();
+    mTaskCondition.broadcast();
+    mTaskMutex.unlock();
+    
+    for (int i=0; i<mTaskWorkers.size(); i++) {
+        mTaskWorkers[i]->waitForThread(false);
+        delete mTaskWorkers[i];
+    }
+    mTaskWorkers.clear();
+}
+
+ofxSaliencyMap::TaskWorker::TaskWorker()
+{
+    owner = NULL;
+}
+
+void ofxSaliencyMap::TaskWorker::setup(ofxSaliencyMap * owner)
+{
+    this->owner = owner;
+}
+
+void ofxSaliencyMap::TaskWorker::threadedFunction()
+{
+    while (isThreadRunning() && owner->runTask(true)) {}
+}
+
+//////////////////////////////////////////////////////////////////
+// Channel Context
+//////////////////////////////////////////////////////////////////
+ofxSaliencyMapChannelContext::ofxSaliencyMapChannelContext(ofxSaliencyMap * owner, const vector<ofxSaliencyMapNodeData> & nodes, CvSize size, ofxSaliencyMapScaleSet scales,
+                                                           const ofxSaliencyMapSurroundTables * tables, ofxSaliencyMapNormTrace * trace)
+: owner(owner), nodes(nodes), size(size), scales(scales), tables(tables), trace(trace)
+{
+}
+
+const vector<CvMat *> & ofxSaliencyMapChannelContext::getInput(const string & name)
+{
+    return SMGetNodeOutputs(nodes, name);
+}
+
+ofxSaliencyMapScaleInfo ofxSaliencyMapChannelContext::getScaleInfo()
 {
+    return SMScaleInfo(scales);
+}
+
+ofxSaliencyMapOrientation & ofxSaliencyMapChannelContext::getOrientationEngine()
+{
+    return owner->mOrientation;
+}
+
+CvMat * ofxSaliencyMapChannelContext::createMap()
+{
+    CvMat * map = SMCreateMat(size.height, size.width, CV_32FC1);
+    cvSetZero(map);
+    return map;
+}
+
+void ofxSaliencyMapChannelContext::addConspicuity(CvMat * src, CvMat * accum)
+{
+    owner->addConspicuity(src, accum, scales, tables, trace);
+}
+
+void ofxSaliencyMapChannelContext::addConspicuityFromPyramid(CvMat * const pyramid[], CvMat * accum)
+{
+    owner->addConspicuityFromPyramid(pyramid, accum, scales, tables, trace);
+}
+
+CvMat * ofxSaliencyMapChannelContext::normalize(CvMat * src)
+{
+    return owner->SMNormalization(src, trace);
+}
+
+//////////////////////////////////////////////////////////////////
+// Sparse Query
+//////////////////////////////////////////////////////////////////
+vector<float> ofxSaliencyMap::querySaliency(const vector<ofRectangle> & regions, vector<ofFloatPixels> * patches)
+{
+    
+    vector<float> scores(regions.size(), 0);
+    if (patches != NULL) patches->assign(regions.size(), ofFloatPixels());
+    mQueryPixels = 0;
+    
     // check source image
     if (!mSrcImg.isAllocated()) {
         cout << "[ERROR] do not read source image" << endl;
-        return;
+        return scores;
     }
     
-    IplImage src = toCv(mSrcImg);
-    
-    // init gabor kernels
     initGabor();
     
-    CvSize sSize = cvSize(mSrcImg.width, mSrcImg.height);
-
-    //----------
-    // Intensity and RGB Extraction
-    //----------
-    
-    CvMat * R, * G, * B, * I;
-    SMExtractRGBI(&src, R, G, B, I);
+    IplImage src = toCv(mSrcImg);
+    CvMat srcHeader;
+    CvMat * srcMat = cvGetMat(&src, &srcHeader);
+    CvSize sSize = cvSize(srcMat->cols, srcMat->rows);
+    
+    // the scale set of the full frame, so that cached statistics and pyramid levels match it
+    ofxSaliencyMapScaleSet scales = resolveScaleSet(sSize);
+    int align = SMScaleInfo(scales).minSize;
+    if (MIN(sSize.width, sSize.height) < align) {
+        cout << "[ERROR] source image is too small for the pyramid depth" << endl;
+        return scores;
+    }
     
-    // intensity feature maps
-    CvMat* IFM[6];
-    IFMGetFM(I, IFM);
+    updatePlan();
+    advanceNodes(srcMat);
     
-    // color feature maps
-    CvMat* CFM_RG[6];
-    CvMat* CFM_BY[6];
-    CFMGetFM(R, G, B, CFM_RG, CFM_BY);
+    // windows start on the coarsest pyramid grid so that their levels line up with the full frame
+    bool cached = mQueryNorm == OFXSALIENCYMAP_QUERY_NORM_CACHED && !mNormCache.empty() &&
+                  mNormCacheScales == scales && mNormCacheRevision == mGraphRevision;
     
-    // orientation feature maps
-    CvMat* OFM[24];
-    OFMGetFM(I, OFM);
+    // region bounds in source pixels, and the window computed around each region
+    vector<CvRect> bounds(regions.size());
+    vector<CvRect> windows;
+    vector<int> windowOf(regions.size(), -1);
+    for (int k=0; k<regions.size(); k++)
+    {
+        
+        int x0 = MAX(0, (int)floor(regions[k].x));
+        int y0 = MAX(0, (int)floor(regions[k].y));
+        int x1 = MIN(sSize.width, (int)ceil(regions[k].x + regions[k].width));
+        int y1 = MIN(sSize.height, (int)ceil(regions[k].y + regions[k].height));
+        if (x1 <= x0 || y1 <= y0) continue;
+        
+        bounds[k] = cvRect(x0, y0, x1 - x0, y1 - y0);
+        windowOf[k] = windows.size();
+        windows.push_back(SMQueryWindow(regions[k], sSize, align));
+        
+    }
     
-    // motion feature maps
-    CvMat* MFM_X[6];
-    CvMat* MFM_Y[6];
-    MFMGetFM(I, MFM_X, MFM_Y);
+    // nearby regions share one footprint, and footprints covering the image are the full frame
+    SMMergeQueryWindows(windows, windowOf);
+    for (int w=0; w<windows.size(); w++) mQueryPixels += (size_t)windows[w].width * windows[w].height;
+    if (mQueryPixels >= (size_t)sSize.width * sSize.height)
+    {
+        
+        windows.assign(1, cvRect(0, 0, sSize.width, sSize.height));
+        for (int k=0; k<windowOf.size(); k++) if (windowOf[k] >= 0) windowOf[k] = 0;
+        mQueryPixels = (size_t)sSize.width * sSize.height;
+        
+    }
     
-    // output RGB and I images
-    CvMat *tmpR = cvCreateMat(sSize.height, sSize.width, CV_8UC1);
-    CvMat *tmpG = cvCreateMat(sSize.height, sSize.width, CV_8UC1);
-    CvMat *tmpB = cvCreateMat(sSize.height, sSize.width, CV_8UC1);
-    CvMat *tmpI = cvCreateMat(sSize.height, sSize.width, CV_8UC1);
-    cvConvertScaleAbs(R, tmpR, 255);
-    cvConvertScaleAbs(G, tmpG, 255);
-    cvConvertScaleAbs(B, tmpB, 255);
-    cvConvertScaleAbs(I, tmpI, 255);
-    mR.setFromPixels((unsigned char*)tmpR->data.ptr, sSize.width, sSize.height, OF_IMAGE_GRAYSCALE);
-    mG.setFromPixels((unsigned char*)tmpG->data.ptr, sSize.width, sSize.height, OF_IMAGE_GRAYSCALE);
-    mB.setFromPixels((unsigned char*)tmpB->data.ptr, sSize.width, sSize.height, OF_IMAGE_GRAYSCALE);
-    mI.setFromPixels((unsigned char*)tmpI->data.ptr, sSize.width, sSize.height, OF_IMAGE_GRAYSCALE);
-    
-    cvReleaseMat(&tmpR);
-    cvReleaseMat(&tmpG);
-    cvReleaseMat(&tmpB);
-    cvReleaseMat(&tmpI);
-    cvReleaseMat(&R);
-    cvReleaseMat(&G);
-    cvReleaseMat(&B);
-    cvReleaseMat(&I);
+    for (int w=0; w<windows.size(); w++)
+    {
+        
+        CvRect window = windows[w];
+        
+        FeatureFrame frame;
+        frame.memory.setParent(SMGetMemoryScope());
+        ofxSaliencyMapMemoryBinding binding(&frame.memory);
+        buildFrame(&frame, srcMat, window, scales);
+        frame.floatOutput = false;
+        produceNodes(&frame);
+        releaseNodes(&frame, -1);
+        if (cached) {
+            frame.traces = mNormCache;
+            for (int i=0; i<frame.traces.size(); i++) {
+                frame.traces[i].cursor = 0;
+                frame.traces[i].replay = true;
+            }
+        }
+        combineFeatures(&frame);
+        
+        // read every region of this window back out of its saliency map
+        for (int k=0; k<regions.size(); k++)
+        {
+            
+            if (windowOf[k] != w) continue;
+            CvMat regionHeader;
+            CvMat * region = cvGetSubRect(frame.SM, &regionHeader, cvRect(bounds[k].x - window.x, bounds[k].y - window.y, bounds[k].width, bounds[k].height));
+            cvMinS(region, 1.0, region);	// cached statistics may overshoot the full frame range
+            cvMaxS(region, 0.0, region);
+            scores[k] = cvAvg(region).val[0];
+            
+            if (patches != NULL) SMOutputFloat(region, (*patches)[k]);
+            
+        }
+        
+        releaseFrame(&frame);
+        
+    }
+    return scores;
     
-    //----------
-    // Generate Conspicuity Map
-    //----------
+}
 
-    CvMat *ICM = ICMGetCM(IFM, sSize);
-    CvMat *CCM = CCMGetCM(CFM_RG, CFM_BY, sSize);
-    CvMat *OCM = OCMGetCM(OFM, sSize);
-    CvMat *MCM = MCMGetCM(MFM_X, MFM_Y, sSize);
+vector<float> ofxSaliencyMap::querySaliency(const vector<ofPoint> & points, vector<ofFloatPixels> * patches)
+{
     
-    for(int i=0; i<6; i++){
+    float size = OFXSALIENCYMAP_DEF_QUERY_POINT_SIZE;
+    vector<ofRectangle> regions;
+    for (int i=0; i<points.size(); i++)
+    {
         
-        cvReleaseMat(&IFM[i]);
-        cvReleaseMat(&CFM_RG[i]);
-        cvReleaseMat(&CFM_BY[i]);
-        cvReleaseMat(&MFM_X[i]);
-        cvReleaseMat(&MFM_Y[i]);
+        regions.push_back(ofRectangle(points[i].x - size * 0.5, points[i].y - size * 0.5, size, size));
         
     }
-    for(int i=0; i<24; i++) cvReleaseMat(&OFM[i]);
+    return querySaliency(regions, patches);
     
-    //----------
-    // Generate Saliency Map
-    //----------
+}
+
+CvRect SMQueryWindow(const ofRectangle & region, CvSize size, int align)
+{
     
-    // Normalize conspicuity maps
-    CvMat *ICM_norm;
-    CvMat *CCM_norm;
-    CvMat *OCM_norm;
-    CvMat *MCM_norm;
-    ICM_norm = SMNormalization(ICM);
-    CCM_norm = SMNormalization(CCM);
-    OCM_norm = SMNormalization(OCM);
-    MCM_norm = SMNormalization(MCM);
-    cvReleaseMat(&ICM);
-    cvReleaseMat(&CCM);
-    cvReleaseMat(&OCM);
-    cvReleaseMat(&MCM);
-    
-    // Adding all the CMs to form Saliency Map
-    CvMat* SM_Mat = cvCreateMat(sSize.height, sSize.width, CV_32FC1);
-    cvAddWeighted(ICM_norm, weightIntensity, OCM_norm, weightOrientation, 0.0, SM_Mat);
-    cvAddWeighted(CCM_norm, weightColor, SM_Mat, 1.00, 0.0, SM_Mat);
-    cvAddWeighted(MCM_norm, weightMotion, SM_Mat, 1.00, 0.0, SM_Mat);
-    cvReleaseMat(&ICM_norm);
-    cvReleaseMat(&CCM_norm);
-    cvReleaseMat(&OCM_norm);
-    cvReleaseMat(&MCM_norm);
+    int margin = OFXSALIENCYMAP_DEF_QUERY_MARGIN;
+    int x0 = (int)floor((region.x - margin) / align) * align;
+    int y0 = (int)floor((region.y - margin) / align) * align;
+    int x1 = (int)ceil((region.x + region.width + margin) / align) * align;
+    int y1 = (int)ceil((region.y + region.height + margin) / align) * align;
+    
+    // clip to the image, keeping at least one coarsest pyramid cell where the image allows it.
+    // the origin stays on the coarsest grid, so the window levels line up with the frame's
+    x0 = MAX(0, x0);
+    y0 = MAX(0, y0);
+    x1 = MIN(size.width, x1);
+    y1 = MIN(size.height, y1);
+    if (x1 - x0 < align) x0 = MAX(0, x1 - align) / align * align;
+    if (y1 - y0 < align) y0 = MAX(0, y1 - align) / align * align;
+    return cvRect(x0, y0, x1 - x0, y1 - y0);
     
-    // Output Result Map
-    CvMat *cvtMat = cvCreateMat(sSize.height, sSize.width, CV_8UC1);
-    CvMat *SM = SMRangeNormalize(SM_Mat);
-    cvConvertScaleAbs(SM, cvtMat, 255);
-    mDstImg.setFromPixels((unsigned char *)cvtMat->data.ptr, cvtMat->cols, cvtMat->rows, OF_IMAGE_GRAYSCALE);
+}
+
+void SMMergeQueryWindows(vector<CvRect> & windows, vector<int> & windowOf)
+{
+    
+    // merge two windows whenever their bounding window costs no more than both of them,
+    // which holds for overlapping and adjacent windows of nearby regions
+    bool merged = true;
+    while (merged)
+    {
+        
+        merged = false;
+        for (int a=0; a<windows.size() && !merged; a++) for (int b=a+1; b<windows.size() && !merged; b++)
+        {
+            
+            int x0 = MIN(windows[a].x, windows[b].x);
+            int y0 = MIN(windows[a].y, windows[b].y);
+            int x1 = MAX(windows[a].x + windows[a].width, windows[b].x + windows[b].width);
+            int y1 = MAX(windows[a].y + windows[a].height, windows[b].y + windows[b].height);
+            size_t joint = (size_t)(x1 - x0) * (y1 - y0);
+            size_t separate = (size_t)windows[a].width * windows[a].height + (size_t)windows[b].width * windows[b].height;
+            if (joint > separate) continue;
+            
+            windows[a] = cvRect(x0, y0, x1 - x0, y1 - y0);
+            windows.erase(windows.begin() + b);
+            for (int k=0; k<windowOf.size(); k++)
+            {
+                
+                if (windowOf[k] == b) windowOf[k] = a;
+                else if (windowOf[k] > b) windowOf[k]--;
+                
+            }
+            merged = true;
+            
+        }
+        
+    }
+    
+}
+
+CvMat* SMExtractI8U(CvMat* src)
+{
     
-    cvReleaseMat(&SM_Mat);
-    cvReleaseMat(&SM);
-    cvReleaseMat(&cvtMat);
+    CvMat * src32F = SMCreateMat(src->rows, src->cols, CV_32FC3);
+    CvMat * I = SMCreateMat(src->rows, src->cols, CV_32FC1);
+    CvMat * I8U = SMCreateMat(src->rows, src->cols, CV_8UC1);
+    cvConvertScale(src, src32F, 1/255.0);
+    cvCvtColor(src32F, I, CV_BGR2GRAY);
+    cvConvertScale(I, I8U, 256);
+    SMReleaseMat(&src32F);
+    SMReleaseMat(&I);
+    return I8U;
     
 }
 
-void ofxSaliencyMap::SMExtractRGBI(IplImage* inputImage, CvMat* &R, CvMat* &G, CvMat* &B, CvMat* &I)
+void SMExtractRGBI(CvMat* inputImage, CvMat* &R, CvMat* &G, CvMat* &B, CvMat* &I)
 {
     
     int height = inputImage->height;
     int width = inputImage->width;
     // convert scale of array elements
-    CvMat * src = cvCreateMat(height, width, CV_32FC3);
+    CvMat * src = SMCreateMat(height, width, CV_32FC3);
     cvConvertScale(inputImage, src, 1/255.0);
     
     // initalize matrix for I,R,G,B
-    R = cvCreateMat(height, width, CV_32FC1);
-    G = cvCreateMat(height, width, CV_32FC1);
-    B = cvCreateMat(height, width, CV_32FC1);
-    I = cvCreateMat(height, width, CV_32FC1);
+    R = SMCreateMat(height, width, CV_32FC1);
+    G = SMCreateMat(height, width, CV_32FC1);
+    B = SMCreateMat(height, width, CV_32FC1);
+    I = SMCreateMat(height, width, CV_32FC1);
     
     // split
     cvSplit(src, B, G, R, NULL);
@@ -180,429 +1296,335 @@ void ofxSaliencyMap::SMExtractRGBI(IplImage* inputImage, CvMat* &R, CvMat* &G, C
     cvCvtColor(src, I, CV_BGR2GRAY);
     
     // release
-    cvReleaseMat(&src);
-    
-}
-
-void ofxSaliencyMap::IFMGetFM(CvMat* src, CvMat* dst[6])
-{
-    
-    FMGaussianPyrCSD(src, dst);
+    SMReleaseMat(&src);
     
 }
 
-void ofxSaliencyMap::CFMGetFM(CvMat* R, CvMat* G, CvMat* B, CvMat* RGFM[6], CvMat* BYFM[6])
+void CFMMaxRGB(CvMat* R, CvMat* G, CvMat* B, CvMat* RGBMax)
 {
     
-    // allocate
-    int height = R->height;
-    int width = R->width;
-    CvMat* tmp1 = cvCreateMat(height, width, CV_32FC1);
-    CvMat* tmp2 = cvCreateMat(height, width, CV_32FC1);
-    CvMat* RGBMax = cvCreateMat(height, width, CV_32FC1);
-    CvMat* RGMin = cvCreateMat(height, width, CV_32FC1);
-    CvMat* RGMat = cvCreateMat(height, width, CV_32FC1);
-    CvMat* BYMat = cvCreateMat(height, width, CV_32FC1);
     // Max(R,G,B)
-    cvMax(R, G, tmp1);
-    cvMax(B, tmp1, RGBMax);
+    cvMax(R, G, RGBMax);
+    cvMax(B, RGBMax, RGBMax);
     cvMaxS(RGBMax, 0.0001, RGBMax); // to prevent dividing by 0
-    // Min(R,G)
-    cvMin(R, G, RGMin);
-    
-    // R-G
-    cvSub(R, G, tmp1);
-    // B-Min(R,G)
-    cvSub(B, RGMin, tmp2);
-    // RG = (R-G)/Max(R,G,B)
-    cvDiv(tmp1, RGBMax, RGMat);
-    // BY = (B-Min(R,G)/Max(R,G,B)
-    cvDiv(tmp2, RGBMax, BYMat);
-    
-    // Clamp negative value to 0 for the RG and BY maps
-    cvMaxS(RGMat, 0, RGMat);
-    cvMaxS(BYMat, 0, BYMat);
-    
-    // Obtain [RG,BY] color opponency feature map by generating Gaussian pyramid and performing center-surround difference
-    FMGaussianPyrCSD(RGMat, RGFM);
-    FMGaussianPyrCSD(BYMat, BYFM);
-    
-    // release
-    cvReleaseMat(&tmp1);
-    cvReleaseMat(&tmp2);
-    cvReleaseMat(&RGBMax);
-    cvReleaseMat(&RGMin);
-    cvReleaseMat(&RGMat);
-    cvReleaseMat(&BYMat);
     
 }
 
-void ofxSaliencyMap::OFMGetFM(CvMat* I, CvMat* dst[24])
+void CFMOpponency(CvMat* R, CvMat* G, CvMat* B, CvMat* RGBMax, CvMat* dst, bool blueYellow)
 {
     
-    // Create gaussian pyramid
-    CvMat* GaussianI[9];
-    FMCreateGaussianPyr(I, GaussianI);
-    
-    // Convolution Gabor filter with intensity feature maps to extract orientation feature
-    CvMat* tempGaborOutput0[9];
-    CvMat* tempGaborOutput45[9];
-    CvMat* tempGaborOutput90[9];
-    CvMat* tempGaborOutput135[9];
-    for(int j=2; j<9; j++)
+    if (blueYellow)
     {
         
-        int now_height = GaussianI[j]->height;
-        int now_width = GaussianI[j]->width;
-        tempGaborOutput0[j] = cvCreateMat(now_height, now_width, CV_32FC1);
-        tempGaborOutput45[j] = cvCreateMat(now_height, now_width, CV_32FC1);
-        tempGaborOutput90[j] = cvCreateMat(now_height, now_width, CV_32FC1);
-        tempGaborOutput135[j] = cvCreateMat(now_height, now_width, CV_32FC1);
-        cvFilter2D(GaussianI[j], tempGaborOutput0[j], GaborKernel0);
-        cvFilter2D(GaussianI[j], tempGaborOutput45[j], GaborKernel45);
-        cvFilter2D(GaussianI[j], tempGaborOutput90[j], GaborKernel90);
-        cvFilter2D(GaussianI[j], tempGaborOutput135[j], GaborKernel135);
+        // BY = (B-Min(R,G))/Max(R,G,B)
+        cvMin(R, G, dst);
+        cvSub(B, dst, dst);
         
     }
-    for(int j=0; j<9; j++) cvReleaseMat(&(GaussianI[j]));
-    
-    // calculate center surround difference for each orientation
-    CvMat* temp0[6];
-    CvMat* temp45[6];
-    CvMat* temp90[6];
-    CvMat* temp135[6];
-    FMCenterSurroundDiff(tempGaborOutput0, temp0);
-    FMCenterSurroundDiff(tempGaborOutput45, temp45);
-    FMCenterSurroundDiff(tempGaborOutput90, temp90);
-    FMCenterSurroundDiff(tempGaborOutput135, temp135);
-    for(int i=2; i<9; i++)
+    else
     {
         
-        cvReleaseMat(&(tempGaborOutput0[i]));
-        cvReleaseMat(&(tempGaborOutput45[i]));
-        cvReleaseMat(&(tempGaborOutput90[i]));
-        cvReleaseMat(&(tempGaborOutput135[i]));
+        // RG = (R-G)/Max(R,G,B)
+        cvSub(R, G, dst);
         
     }
-    // saving the 6 center-surround difference feature map of each angle configuration to the destination pointer
-    for(int i=0; i<6; i++)
+    cvDiv(dst, RGBMax, dst);
+    
+    // Clamp negative value to 0
+    cvMaxS(dst, 0, dst);
+    
+}
+
+template<class Scales>
+void FMCreateGaussianPyr(CvMat* src, CvMat* dst[Scales::LEVELS])
+{
+    
+    dst[0] = SMCloneMat(src);
+    for(int i=1; i<Scales::LEVELS; i++)
     {
         
-        dst[i] = temp0[i];
-        dst[i+6] = temp45[i];
-        dst[i+12] = temp90[i];
-        dst[i+18] = temp135[i];
+        dst[i] = SMCreateMat(dst[i-1]->height/2, dst[i-1]->width/2, CV_32FC1);
+        cvPyrDown(dst[i-1], dst[i], CV_GAUSSIAN_5x5);
         
     }
     
 }
 
-void ofxSaliencyMap::MFMGetFM(CvMat* I, CvMat* dst_x[], CvMat* dst_y[])
+int FMCreateGaussianPyr(CvMat* src, CvMat* dst[], ofxSaliencyMapScaleSet scales)
 {
     
-    int height = I->height;
-    int width = I->width;
-    // convert
-    CvMat* I8U = cvCreateMat(height, width, CV_8UC1);
-    cvConvertScale(I, I8U, 256);
+    switch (scales) {
+        case OFXSALIENCYMAP_SCALES_VGA: FMCreateGaussianPyr<ofxSaliencyMapScalesVGA>(src, dst); return ofxSaliencyMapScalesVGA::LEVELS;
+        case OFXSALIENCYMAP_SCALES_QVGA: FMCreateGaussianPyr<ofxSaliencyMapScalesQVGA>(src, dst); return ofxSaliencyMapScalesQVGA::LEVELS;
+        case OFXSALIENCYMAP_SCALES_QQVGA: FMCreateGaussianPyr<ofxSaliencyMapScalesQQVGA>(src, dst); return ofxSaliencyMapScalesQQVGA::LEVELS;
+        default: FMCreateGaussianPyr<ofxSaliencyMapScalesDefault>(src, dst); return ofxSaliencyMapScalesDefault::LEVELS;
+    }
+    
+}
+
+void ofxSaliencyMapLinearTable::setup(int dst_size, int src_size)
+{
     
-    // obtain optical flow information
-    CvMat* flowx = cvCreateMat(height, width, CV_32FC1);
-    CvMat* flowy = cvCreateMat(height, width, CV_32FC1);
-    cvSetZero(flowx);
-    cvSetZero(flowy);
-    if(this->prev_frame!=NULL)
+    i0.resize(dst_size);
+    i1.resize(dst_size);
+    w.resize(dst_size);
+    double scale = (double)src_size / dst_size;
+    for (int d=0; d<dst_size; d++)
     {
         
-        cvCalcOpticalFlowLK(this->prev_frame, I8U, cvSize(7,7), flowx, flowy);
-        cvReleaseMat(&(this->prev_frame));
+        double fs = (d + 0.5) * scale - 0.5;
+        int s0 = (int)floor(fs);
+        float f = (float)(fs - s0);
+        if (s0 < 0) { s0 = 0; f = 0; }
+        if (s0 >= src_size - 1) { s0 = src_size - 1; f = 0; }
+        i0[d] = s0;
+        i1[d] = MIN(s0 + 1, src_size - 1);
+        w[d] = f;
         
     }
-    // create Gaussian pyramid
-    FMGaussianPyrCSD(flowx, dst_x);
-    FMGaussianPyrCSD(flowy, dst_y);
     
-    // update
-    this->prev_frame = cvCloneMat(I8U);
+}
+
+void ofxSaliencyMapSurroundTables::setup(CvSize size, ofxSaliencyMapScaleSet scales)
+{
     
-    // release
-    cvReleaseMat(&flowx);
-    cvReleaseMat(&flowy);
-    cvReleaseMat(&I8U);
+    this->size = size;
+    this->scales = scales;
+    info = SMScaleInfo(scales);
+    levels[0] = size;
+    for (int i=1; i<info.levels; i++) levels[i] = cvSize(levels[i-1].width/2, levels[i-1].height/2);
+    build();
     
 }
 
-void FMGaussianPyrCSD(CvMat* src, CvMat* dst[6])
+void ofxSaliencyMapSurroundTables::setup(CvMat * const pyramid[], const ofxSaliencyMapScaleInfo & info)
 {
     
-    CvMat *GaussianMap[9];
-    FMCreateGaussianPyr(src, GaussianMap);
-    FMCenterSurroundDiff(GaussianMap, dst);
-    for(int i=0; i<9; i++) cvReleaseMat(&(GaussianMap[i]));
+    this->info = info;
+    scales = OFXSALIENCYMAP_SCALES_AUTO;
+    for (int i=0; i<info.levels; i++) levels[i] = i < info.centerBegin ? cvSize(0, 0) : cvGetSize(pyramid[i]);
+    size = levels[0];
+    build();
     
 }
 
-void FMCreateGaussianPyr(CvMat* src, CvMat* dst[9])
+void ofxSaliencyMapSurroundTables::build()
 {
     
-    dst[0] = cvCloneMat(src);
-    for(int i=1; i<9; i++)
+    for (int s=info.centerBegin; s<info.centerEnd; s++)
     {
         
-        dst[i] = cvCreateMat(dst[i-1]->height/2, dst[i-1]->width/2, CV_32FC1);
-        cvPyrDown(dst[i-1], dst[i], CV_GAUSSIAN_5x5);
+        for (int d=0; d<2; d++)
+        {
+            
+            int m = (s - info.centerBegin) * 2 + d;
+            CvSize surround = levels[s + (d == 0 ? info.delta0 : info.delta1)];
+            x[m].setup(levels[s].width, surround.width);
+            y[m].setup(levels[s].height, surround.height);
+            
+        }
         
     }
     
 }
 
-void FMCenterSurroundDiff(CvMat* GaussianMap[9], CvMat* dst[6])
+bool ofxSaliencyMapSurroundTables::matches(CvMat * const pyramid[]) const
 {
     
-    int i=0;
-    for(int s=2; s<5; s++)
+    for (int i=info.centerBegin; i<info.levels; i++)
     {
         
-        int now_height  = GaussianMap[s]->height;
-        int now_width   = GaussianMap[s]->width;
-        CvMat * tmp     = cvCreateMat(now_height, now_width, CV_32FC1);
-        dst[i]          = cvCreateMat(now_height, now_width, CV_32FC1);
-        dst[i+1]        = cvCreateMat(now_height, now_width, CV_32FC1);
-        cvResize(GaussianMap[s+3], tmp, CV_INTER_LINEAR);
-        cvAbsDiff(GaussianMap[s], tmp, dst[i]);
-        cvResize(GaussianMap[s+4], tmp, CV_INTER_LINEAR);
-        cvAbsDiff(GaussianMap[s], tmp, dst[i+1]);
-        cvReleaseMat(&tmp);
-        i += 2;
+        if (pyramid[i]->cols != levels[i].width || pyramid[i]->rows != levels[i].height) return false;
         
     }
+    return true;
     
 }
 
-void ofxSaliencyMap::normalizeFeatureMaps(CvMat *FM[], CvMat *NFM[], int width, int height, int num_maps)
+ofxSaliencyMap::SurroundTablesPtr ofxSaliencyMap::getSurroundTables(CvSize size, ofxSaliencyMapScaleSet scales)
 {
     
-    for(int i=0; i<num_maps; i++)
+    for (int i=0; i<mSurroundTables.size(); i++)
     {
         
-        CvMat * normalizedImage = SMNormalization(FM[i]);
-        NFM[i] = cvCreateMat(height, width, CV_32FC1);
-        cvResize(normalizedImage, NFM[i], CV_INTER_LINEAR);
-        cvReleaseMat(&normalizedImage);
+        SurroundTablesPtr tables = mSurroundTables[i];
+        if (tables->scales != scales || tables->size.width != size.width || tables->size.height != size.height) continue;
+        mSurroundTables.erase(mSurroundTables.begin() + i);
+        mSurroundTables.insert(mSurroundTables.begin(), tables);
+        return tables;
         
     }
     
-}
-CvMat* ofxSaliencyMap::SMNormalization(CvMat* src)
-{
-    
-    CvMat* result = cvCreateMat(src->height, src->width, CV_32FC1);
-    
-    // normalize so that the pixel value lies between 0 and 1
-    CvMat* tempResult = SMRangeNormalize(src);
-    // single-peak emphasis / multi-peak suppression
-    double lmaxmean = SMAvgLocalMax(tempResult);
-    double normCoeff = (1-lmaxmean)*(1-lmaxmean);
-    cvConvertScale(tempResult, result, normCoeff);
-    cvReleaseMat(&tempResult);
-    return result;
+    // frames still in flight keep their own reference to an evicted entry
+    SurroundTablesPtr tables = new SurroundTables();
+    tables->setup(size, scales);
+    mSurroundTables.insert(mSurroundTables.begin(), tables);
+    if (mSurroundTables.size() > OFXSALIENCYMAP_DEF_SURROUND_TABLE_CACHE) mSurroundTables.pop_back();
+    return tables;
     
 }
-CvMat* ofxSaliencyMap::SMRangeNormalize(CvMat* src)
+
+// |center - bilinear(surround)| straight into dst, without materializing the upsampled surround
+void FMCenterSurroundPair(CvMat* center, CvMat* surround, CvMat* dst, const ofxSaliencyMapLinearTable & tx, const ofxSaliencyMapLinearTable & ty)
 {
     
-    double maxx, minn;
-    cvMinMaxLoc(src, &minn, &maxx);
-    CvMat* result = cvCreateMat(src->height, src->width, CV_32FC1);
-    if(maxx!=minn) cvConvertScale(src, result, 1/(maxx-minn), minn/(minn-maxx));
-    else cvConvertScale(src, result, 1, -minn);
-    return result;
-    
-}
-double SMAvgLocalMax(CvMat* src)
-{
+    int height = center->height;
+    int width = center->width;
     
-    int stepsize = OFXSALIENCYMAP_DEF_DEFAULT_STEP_LOCAL;
-    int numlocal = 0;
-    double lmaxmean = 0, lmax = 0, dummy = 0;
-    CvMat localMatHeader;
-    cvInitMatHeader(&localMatHeader, stepsize, stepsize, CV_32FC1, src->data.ptr, src->step);
-    for(int y=0; y<src->height-stepsize; y+=stepsize) // Note: the last several pixels may be ignored.
+    for (int y=0; y<height; y++)
     {
         
-        for(int x=0; x<src->width-stepsize; x+=stepsize)
+        const float * c = (const float *)(center->data.ptr + y * center->step);
+        const float * s0 = (const float *)(surround->data.ptr + ty.i0[y] * surround->step);
+        const float * s1 = (const float *)(surround->data.ptr + ty.i1[y] * surround->step);
+        float * d = (float *)(dst->data.ptr + y * dst->step);
+        float wy = ty.w[y];
+        
+        for (int x=0; x<width; x++)
         {
             
-            localMatHeader.data.ptr = src->data.ptr+sizeof(float)*x+src->step*y;	// get local matrix by pointer trick
-            cvMinMaxLoc(&localMatHeader, &dummy, &lmax);
-            lmaxmean += lmax;
-            numlocal++;
+            int x0 = tx.i0[x];
+            int x1 = tx.i1[x];
+            float wx = tx.w[x];
+            float top = s0[x0] + (s0[x1] - s0[x0]) * wx;
+            float bottom = s1[x0] + (s1[x1] - s1[x0]) * wx;
+            d[x] = fabsf(c[x] - (top + (bottom - top) * wy));
             
         }
         
     }
-    return lmaxmean/numlocal;
     
 }
 
-CvMat * ofxSaliencyMap::ICMGetCM(CvMat *IFM[], CvSize size)
+ofxSaliencyMapScaleInfo SMScaleInfo(ofxSaliencyMapScaleSet scales)
+{
+    
+    switch (scales) {
+        case OFXSALIENCYMAP_SCALES_VGA: return ofxSaliencyMapScalesVGA::info();
+        case OFXSALIENCYMAP_SCALES_QVGA: return ofxSaliencyMapScalesQVGA::info();
+        case OFXSALIENCYMAP_SCALES_QQVGA: return ofxSaliencyMapScalesQQVGA::info();
+        default: return ofxSaliencyMapScalesDefault::info();
+    }
+    
+}
+
+ofxSaliencyMapScaleSet ofxSaliencyMap::resolveScaleSet(CvSize size)
 {
     
-    int num_FMs = 6;
-    // Normalize all intensity feature maps
-    CvMat * NIFM[6];
-    normalizeFeatureMaps(IFM, NIFM, size.width, size.height, num_FMs);
+    if (mScaleSet != OFXSALIENCYMAP_SCALES_AUTO) return mScaleSet;
     
-    // Formulate intensity conspicuity map by summing up the normalized intensity feature maps
-    CvMat *ICM = cvCreateMat(size.height, size.width, CV_32FC1);
-    cvSetZero(ICM);
-    for (int i=0; i<num_FMs; i++)
+    // deepest preset whose coarsest level keeps OFXSALIENCYMAP_DEF_MIN_TOP_LEVEL pixels on the shortest side
+    static const ofxSaliencyMapScaleSet presets[] = {
+        OFXSALIENCYMAP_SCALES_DEFAULT,
+        OFXSALIENCYMAP_SCALES_VGA,
+        OFXSALIENCYMAP_SCALES_QVGA,
+        OFXSALIENCYMAP_SCALES_QQVGA
+    };
+    int shortest = MIN(size.width, size.height);
+    for (int i=0; i<4; i++)
     {
         
-        cvAdd(ICM, NIFM[i], ICM);
-        cvReleaseMat(&NIFM[i]);
+        if (shortest / SMScaleInfo(presets[i]).minSize >= OFXSALIENCYMAP_DEF_MIN_TOP_LEVEL) return presets[i];
         
     }
-    return ICM;
+    return OFXSALIENCYMAP_SCALES_QQVGA;
     
 }
-CvMat * ofxSaliencyMap::CCMGetCM(CvMat *CFM_RG[], CvMat *CFM_BY[], CvSize size)
+
+CvMat* ofxSaliencyMap::SMNormalization(CvMat* src, NormTrace * trace)
 {
     
-//    int num_FMs = 6;
-    CvMat* CCM_RG = ICMGetCM(CFM_RG, size);
-    CvMat* CCM_BY = ICMGetCM(CFM_BY, size);
-    CvMat *CCM = cvCreateMat(size.height, size.width, CV_32FC1);
-    cvAdd(CCM_BY, CCM_RG, CCM);
+    CvMat* result = SMCreateMat(src->height, src->width, CV_32FC1);
     
-    cvReleaseMat(&CCM_BY);
-    cvReleaseMat(&CCM_RG);
+    // replay the statistics of a full frame (sparse query), or measure and record them
+    ofxSaliencyMapNormStats stats;
+    bool replay = trace != NULL && trace->replay && trace->cursor < trace->stats.size();
+    if (replay) stats = trace->stats[trace->cursor++];
+    else cvMinMaxLoc(src, &stats.minVal, &stats.maxVal);
     
-    return CCM;
+    // normalize so that the pixel value lies between 0 and 1
+    CvMat* tempResult = SMRangeNormalizeWith(src, stats.minVal, stats.maxVal);
+    if (!replay)
+    {
+        
+        // single-peak emphasis / multi-peak suppression
+        double lmaxmean = SMAvgLocalMax(tempResult);
+        stats.coeff = (1-lmaxmean)*(1-lmaxmean);
+        if (trace != NULL && !trace->replay) trace->stats.push_back(stats);
+        
+    }
+    cvConvertScale(tempResult, result, stats.coeff);
+    SMReleaseMat(&tempResult);
+    return result;
     
 }
-CvMat * ofxSaliencyMap::OCMGetCM(CvMat *OFM[], CvSize size)
+CvMat* ofxSaliencyMap::SMRangeNormalize(CvMat* src, NormTrace * trace)
 {
     
-    int num_FMs_perAngle = 6;
-//    int num_angles = 4;
-//    int num_FMs = num_FMs_perAngle * num_angles;
-    // split feature maps into four sets
-    CvMat * OFM0[6];
-    CvMat * OFM45[6];
-    CvMat * OFM90[6];
-    CvMat * OFM135[6];
-    for (int i=0; i<num_FMs_perAngle; i++)
+    ofxSaliencyMapNormStats stats;
+    bool replay = trace != NULL && trace->replay && trace->cursor < trace->stats.size();
+    if (replay) stats = trace->stats[trace->cursor++];
+    else
     {
         
-        OFM0[i] = OFM[0*num_FMs_perAngle+i];
-        OFM45[i] = OFM[1*num_FMs_perAngle+i];
-        OFM90[i] = OFM[2*num_FMs_perAngle+i];
-        OFM135[i] = OFM[3*num_FMs_perAngle+i];
+        cvMinMaxLoc(src, &stats.minVal, &stats.maxVal);
+        stats.coeff = 1;
+        if (trace != NULL && !trace->replay) trace->stats.push_back(stats);
         
     }
-    // extract conspicuity map for each angle
-    CvMat * NOFM_tmp[4];
-    NOFM_tmp[0] = ICMGetCM(OFM0, size);
-    NOFM_tmp[1] = ICMGetCM(OFM45, size);
-    NOFM_tmp[2] = ICMGetCM(OFM90, size);
-    NOFM_tmp[3] = ICMGetCM(OFM135, size);
+    return SMRangeNormalizeWith(src, stats.minVal, stats.maxVal);
     
-    // Normalize all orientation features map grouped by their orientation angles
-    CvMat* NOFM[4];
-    for (int i=0; i<4; i++)
+}
+CvMat* SMRangeNormalizeWith(CvMat* src, double minn, double maxx)
+{
+    
+    CvMat* result = SMCreateMat(src->height, src->width, CV_32FC1);
+    if(maxx!=minn) cvConvertScale(src, result, 1/(maxx-minn), minn/(minn-maxx));
+    else cvConvertScale(src, result, 1, -minn);
+    return result;
+    
+}
+double SMAvgLocalMax(CvMat* src)
+{
+    
+    int stepsize = OFXSALIENCYMAP_DEF_DEFAULT_STEP_LOCAL;
+    int numlocal = 0;
+    double lmaxmean = 0, lmax = 0, dummy = 0;
+    CvMat localMatHeader;
+    cvInitMatHeader(&localMatHeader, stepsize, stepsize, CV_32FC1, src->data.ptr, src->step);
+    for(int y=0; y<src->height-stepsize; y+=stepsize) // Note: the last several pixels may be ignored.
     {
         
-        NOFM[i] = SMNormalization(NOFM_tmp[i]);
-        cvReleaseMat(&NOFM_tmp[i]);
+        for(int x=0; x<src->width-stepsize; x+=stepsize)
+        {
+            
+            localMatHeader.data.ptr = src->data.ptr+sizeof(float)*x+src->step*y;	// get local matrix by pointer trick
+            cvMinMaxLoc(&localMatHeader, &dummy, &lmax);
+            lmaxmean += lmax;
+            numlocal++;
+            
+        }
         
     }
-    // Sum up all orientation feature maps, and form orientation conspicuity map
-    CvMat *OCM = cvCreateMat(size.height, size.width, CV_32FC1);
-    cvSetZero(OCM);
-    for(int i=0; i<4; i++)
+    
+    // a map of no more than one step per side is a single local region
+    if (numlocal == 0)
     {
         
-        cvAdd(NOFM[i], OCM, OCM);
-        cvReleaseMat(&NOFM[i]);
+        cvMinMaxLoc(src, &dummy, &lmax);
+        return lmax;
         
     }
-    return OCM;
+    return lmaxmean/numlocal;
     
 }
-CvMat * ofxSaliencyMap::MCMGetCM(CvMat *MFM_X[], CvMat *MFM_Y[], CvSize size)
-{
-    return CCMGetCM(MFM_X, MFM_Y, size);
-}
 
 void ofxSaliencyMap::initGabor()
 {
-    static const double	GaborKernel_0[9][9] = {
-        
-        {1.85212E-06,	1.28181E-05,	-0.000350433,	-0.000136537, 0.002010422,	-0.000136537,	-0.000350433,	1.28181E-05, 1.85212E-06},
-        {2.80209E-05,	0.000193926,	-0.005301717,	-0.002065674, 0.030415784,	-0.002065674,	-0.005301717,	0.000193926, 2.80209E-05},
-        {0.000195076,	0.001350077,	-0.036909595,   -0.014380852,   0.211749204,	-0.014380852,	-0.036909595, 0.001350077,	0.000195076},
-        {0.00062494,	0.004325061,	-0.118242318,	-0.046070008, 0.678352526,	-0.046070008,	-0.118242318,	0.004325061, 0.00062494},
-        {0.000921261,	0.006375831,	-0.174308068, -0.067914552,	1,	 -0.067914552,	-0.174308068, 0.006375831,	0.000921261},
-        {0.00062494,	0.004325061,	-0.118242318,	-0.046070008, 0.678352526,	-0.046070008,	-0.118242318,	0.004325061, 0.00062494},
-        {0.000195076,	0.001350077,	-0.036909595, -0.014380852,	0.211749204,	-0.014380852,	-0.036909595, 0.001350077,	0.000195076},
-        {2.80209E-05,	0.000193926,	-0.005301717,	-0.002065674, 0.030415784,	-0.002065674,	-0.005301717,	0.000193926, 2.80209E-05},
-        {1.85212E-06,	1.28181E-05,	-0.000350433,	-0.000136537, 0.002010422,	-0.000136537,	-0.000350433,	1.28181E-05, 1.85212E-06}
-        
-    };
-    static const double	GaborKernel_45[9][9] = {
-        
-        {4.0418E-06,	2.2532E-05,	 -0.000279806,	-0.001028923, 3.79931E-05,	0.000744712,	0.000132863,	-9.04408E-06, -1.01551E-06},
-        {2.2532E-05,	0.00092512,	 0.002373205,	-0.013561362, -0.0229477,	 0.000389916,	0.003516954	,	0.000288732, -9.04408E-06},
-        {-0.000279806,	0.002373205,	0.044837725,	0.052928748, -0.139178011,	-0.108372072,	0.000847346	,	0.003516954, 0.000132863},
-        {-0.001028923,	-0.013561362,	0.052928748,	0.46016215, 0.249959607,	-0.302454279,	-0.108372072,	0.000389916, 0.000744712},
-        {3.79931E-05,	-0.0229477,	 -0.139178011,	0.249959607, 1,	 0.249959607,	-0.139178011,	-0.0229477,	 3.79931E-05},
-        {0.000744712,	0.000389916,	-0.108372072, -0.302454279,	0.249959607,	0.46016215,	 0.052928748, -0.013561362,	-0.001028923},
-        {0.000132863,	0.003516954,	0.000847346,	-0.108372072, -0.139178011,	0.052928748,	0.044837725,	0.002373205, -0.000279806},
-        {-9.04408E-06,	0.000288732,	0.003516954,	0.000389916, -0.0229477,	 -0.013561362,	0.002373205,	0.00092512, 2.2532E-05},
-        {-1.01551E-06,	-9.04408E-06,	0.000132863,	0.000744712, 3.79931E-05,	-0.001028923,	-0.000279806,	2.2532E-05, 4.0418E-06}
-        
-    };
-    static const double GaborKernel_90[9][9] = {
-        
-        {1.85212E-06,	2.80209E-05,	0.000195076,	0.00062494, 0.000921261,	0.00062494,	 0.000195076,	2.80209E-05, 1.85212E-06},
-        {1.28181E-05,	0.000193926,	0.001350077,	0.004325061, 0.006375831,	0.004325061,	0.001350077,	0.000193926, 1.28181E-05},
-        {-0.000350433,	-0.005301717,	-0.036909595, -0.118242318,	-0.174308068,	-0.118242318, -0.036909595,	-0.005301717,	-0.000350433},
-        {-0.000136537,	-0.002065674,	-0.014380852, -0.046070008,	-0.067914552,	-0.046070008, -0.014380852,	-0.002065674,	-0.000136537},
-        {0.002010422,	0.030415784,	0.211749204,	0.678352526, 1,	 0.678352526,	0.211749204,	0.030415784, 0.002010422},
-        {-0.000136537,	-0.002065674,	-0.014380852, -0.046070008,	-0.067914552,	-0.046070008, -0.014380852,	-0.002065674,	-0.000136537},
-        {-0.000350433,	-0.005301717,	-0.036909595, -0.118242318,	-0.174308068,	-0.118242318, -0.036909595,	-0.005301717,	-0.000350433},
-        {1.28181E-05,	0.000193926,	0.001350077,	0.004325061, 0.006375831,	0.004325061,	0.001350077,	0.000193926, 1.28181E-05},
-        {1.85212E-06,	2.80209E-05,	0.000195076,	0.00062494, 0.000921261,	0.00062494,	 0.000195076,	2.80209E-05, 1.85212E-06}
-        
-    };
-    static const double	GaborKernel_135[9][9] = {
-        
-        {-1.01551E-06,	-9.04408E-06,	0.000132863,	0.000744712, 3.79931E-05,	-0.001028923,	-0.000279806,	2.2532E-05, 4.0418E-06},
-        {-9.04408E-06,	0.000288732,	0.003516954,	0.000389916, -0.0229477,	 -0.013561362,	0.002373205,	0.00092512, 2.2532E-05},
-        {0.000132863,	0.003516954,	0.000847346,	-0.108372072, -0.139178011,	0.052928748,	0.044837725,	0.002373205, -0.000279806},
-        {0.000744712,	0.000389916,	-0.108372072, -0.302454279,	0.249959607,	0.46016215,	 0.052928748, -0.013561362,	-0.001028923},
-        {3.79931E-05,	-0.0229477,	 -0.139178011,	0.249959607, 1,	 0.249959607,	-0.139178011,	-0.0229477,	 3.79931E-05},
-        {-0.001028923,	-0.013561362,	0.052928748,	0.46016215, 0.249959607	,	-0.302454279,	-0.108372072,	0.000389916, 0.000744712},
-        {-0.000279806,	0.002373205,	0.044837725,	0.052928748, -0.139178011,	-0.108372072,	0.000847346,	0.003516954, 0.000132863},
-        {2.2532E-05,	0.00092512,	 0.002373205,	-0.013561362, -0.0229477,	 0.000389916,	0.003516954,	0.000288732, -9.04408E-06},
-        {4.0418E-06,	2.2532E-05,	 -0.000279806,	-0.001028923, 3.79931E-05	,	0.000744712,	0.000132863,	-9.04408E-06, -1.01551E-06}
-        
-    };
+    // the orientation filter bank is built once
+    if (mOrientation.isSetup()) return;
     
-    // previous frame information
-    prev_frame = NULL;
-    //Set Gabor Kernel (9x9)
-    GaborKernel0 = cvCreateMat(9, 9, CV_32FC1);
-    GaborKernel45 = cvCreateMat(9, 9, CV_32FC1);
-    GaborKernel90 = cvCreateMat(9, 9, CV_32FC1);
-    GaborKernel135 = cvCreateMat(9, 9, CV_32FC1);
-    for(int i=0; i<9; i++) for(int j=0; j<9; j++){
-        cvmSet(GaborKernel0, i, j, GaborKernel_0[i][j]);	 // 0 degree orientation
-        cvmSet(GaborKernel45, i, j, GaborKernel_45[i][j]); // 45 degree orientation
-        cvmSet(GaborKernel90, i, j, GaborKernel_90[i][j]); // 90 degree orientation
-        cvmSet(GaborKernel135, i, j, GaborKernel_135[i][j]); // 135 degree orientation
-    }
+    mOrientation.setup(mOrientationMode);
 }
 
 void ofxSaliencyMap::initParams()
@@ -622,6 +1644,7 @@ void ofxSaliencyMap::setSourceImage(ofImage srcImg)
 {
     if (srcImg.isAllocated()) {
         mSrcImg = srcImg;
+        mSourceSerial++;
     }
 }
 
@@ -629,25 +1652,83 @@ void ofxSaliencyMap::setSourceImage(ofPixels srcPix)
 {
     if (srcPix.isAllocated()) {
         mSrcImg.setFromPixels(srcPix);
+        mSourceSerial++;
+    }
+}
+
+void ofxSaliencyMap::setUseTexture(const bool use)
+{
+    mSrcImg.setUseTexture(use);
+    mDstImg.setUseTexture(use);
+    mR.setUseTexture(use);
+    mG.setUseTexture(use);
+    mB.setUseTexture(use);
+    mI.setUseTexture(use);
+}
+
+void ofxSaliencyMap::setQueryNormalization(const ofxSaliencyMapQueryNorm mode)
+{
+    mQueryNorm = mode;
+}
+
+bool ofxSaliencyMap::setOrientationMode(const ofxSaliencyMapOrientationMode mode)
+{
+    // the orientation channel of a pipelined frame may still be filtering
+    flushPipeline();
+    if (!mOrientation.setup(mode)) return false;
+    mOrientationMode = mode;
+    return true;
+}
+
+bool ofxSaliencyMap::setOrientations(const vector<float> & degrees)
+{
+    flushPipeline();
+    initGabor();
+    if (!mOrientation.setOrientations(degrees)) return false;
+    // cached statistics no longer match the number of orientation maps
+    mGraphRevision++;
+    return true;
+}
+
+void ofxSaliencyMap::setScaleSet(const ofxSaliencyMapScaleSet scales)
+{
+    mScaleSet = scales;
+}
+
+void ofxSaliencyMap::setLowMemoryEnabled(const bool enable)
+{
+    bLowMemory = enable;
+}
+
+void ofxSaliencyMap::setFloatOutputEnabled(const bool enable)
+{
+    bFloatOutput = enable;
+}
+
+const ofFloatPixels & ofxSaliencyMap::getConspicuityMap(const string & name)
+{
+    for (int i=0; i<mConspicuityNames.size(); i++) {
+        if (mConspicuityNames[i] == name) return mConspicuity[i];
     }
+    return mNoMap;
 }
 
 void ofxSaliencyMap::setWeightIntensity(const float val)
 {
-    weightIntensity = val;
+    mIntensityChannel.setWeight(val);
 }
 
 void ofxSaliencyMap::setWeightColor(const float val)
 {
-    weightColor = val;
+    mColorChannel.setWeight(val);
 }
 
 void ofxSaliencyMap::setWeightOrientation(const float val)
 {
-    weightOrientation = val;
+    mOrientationChannel.setWeight(val);
 }
 
 void ofxSaliencyMap::setWeightMotion(const float val)
 {
-    weightMotion = val;
+    mMotionChannel.setWeight(val);
 }
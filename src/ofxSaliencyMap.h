@@ -11,6 +11,10 @@
 
 #include "ofMain.h"
 #include "ofxCv.h" //<------------------- require!
+#include "Poco/Condition.h"
+#include "Poco/SharedPtr.h"
+#include <deque>
+#include "ofxSaliencyMapChannel.h"
 
 // default definition params
 static const float OFXSALIENCYMAP_DEF_WEIGHT_INTENSITY      = 0.30;
@@ -20,6 +24,15 @@ static const float OFXSALIENCYMAP_DEF_WEIGHT_MOTION         = 0.20;
 static const float OFXSALIENCYMAP_DEF_RANGEMAX              = 255.00;
 static const float OFXSALIENCYMAP_DEF_SCALE_GAUSS_PYRAMID   = 1.7782794100389228012254211951927;	// = 100^0.125
 static const int   OFXSALIENCYMAP_DEF_DEFAULT_STEP_LOCAL    = 8;
+static const int   OFXSALIENCYMAP_DEF_QUERY_MARGIN          = 64;	// source pixels computed around each query region
+static const int   OFXSALIENCYMAP_DEF_QUERY_POINT_SIZE      = 16;	// region size of a point query
+static const int   OFXSALIENCYMAP_DEF_SURROUND_TABLE_CACHE  = 4;	// frame and window sizes whose sampling tables are kept
+
+// normalization used by querySaliency()
+enum ofxSaliencyMapQueryNorm {
+    OFXSALIENCYMAP_QUERY_NORM_CACHED,	// statistics of the last full frame delivered, local until one exists
+    OFXSALIENCYMAP_QUERY_NORM_LOCAL	// statistics of each query window only (approximation)
+};
 
 class ofxSaliencyMap {
 public:
@@ -29,6 +42,80 @@ public:
     
     void createSaliencyMap();
     
+    // pipelined video mode: the nodes and the conspicuity maps of the channels of the frame given to
+    // createSaliencyMap() are extracted while their normalization, the blend and the output of the
+    // previous frame run on a worker thread, so each result is delivered one call late.
+    // flushPipeline() delivers the last pending frame.
+    void setPipelineEnabled(const bool enable);
+    void flushPipeline();
+    inline bool isPipelineEnabled(){ return bPipeline; }
+    
+    // sparse saliency of the current source image: only the pyramid footprints around each
+    // region are computed. returns the mean saliency (0-1) of each region, and optionally
+    // the saliency patch of each region. points are queried as small regions around them.
+    // nearby regions share one footprint; footprints as large as the image are the full frame.
+    // while pipelining, the cached normalization is that of the frame delivered last, one source
+    // image behind the one queried; call flushPipeline() first for the statistics of the current one.
+    vector<float> querySaliency(const vector<ofRectangle> & regions, vector<ofFloatPixels> * patches = NULL);
+    vector<float> querySaliency(const vector<ofPoint> & points, vector<ofFloatPixels> * patches = NULL);
+    void setQueryNormalization(const ofxSaliencyMapQueryNorm mode);
+    inline size_t getQueryPixels(){ return mQueryPixels; }	// source pixels computed by the last querySaliency()
+    
+    // orientation channel: dense 9x9 Gabor filtering of any angles (default), or the separable
+    // engine for 0, 45, 90 and 135 degrees. both return false, and keep the current setting, when
+    // the separable engine would get another angle (see ofxSaliencyMapOrientation.h).
+    bool setOrientationMode(const ofxSaliencyMapOrientationMode mode);
+    bool setOrientations(const vector<float> & degrees);
+    inline ofxSaliencyMapOrientation & getOrientationEngine(){ return mOrientation; }
+    
+    // pyramid depth and center-surround scales (see ofxSaliencyMapScales.h). OFXSALIENCYMAP_SCALES_AUTO
+    // by default, which is the 9-level preset for sources of 768 pixels and more on the shortest side
+    void setScaleSet(const ofxSaliencyMapScaleSet scales);
+    inline ofxSaliencyMapScaleSet getScaleSet(){ return mScaleSet; }
+    
+    // frame graph: nodes produce named intermediates (ofxSaliencyMapNode.h) and channels read
+    // them by name. every node some channel needs is produced once per frame after its
+    // dependencies, independent nodes and the channels run concurrently on the scheduler
+    // threads, and the conspicuity maps are blended in registration order. a channel whose
+    // inputs cannot be resolved (unknown node, dependency cycle) is reported and skipped.
+    // the built-in rgbi, intensityPyramid, opponency and motion nodes and the intensity, color,
+    // orientation and motion channels are registered by default; added nodes and channels are
+    // not owned and must outlive their registration. a node replaces the one of the same name.
+    void addChannel(ofxSaliencyMapChannel * channel);
+    void removeChannel(ofxSaliencyMapChannel * channel);
+    ofxSaliencyMapChannel * getChannel(const string & name);
+    inline const vector<ofxSaliencyMapChannel *> & getChannels(){ return mChannels; }
+    void addNode(ofxSaliencyMapNode * node);
+    void removeNode(ofxSaliencyMapNode * node);
+    ofxSaliencyMapNode * getNode(const string & name);
+    inline const vector<ofxSaliencyMapNode *> & getNodes(){ return mNodes; }
+    
+    // scheduler threads besides the calling thread. 0 (default): nodes and channels run one after another on it.
+    // the calling thread works on the tasks too, so three threads are enough for the four built-in channels.
+    void setNumThreads(const int num);
+    inline int getNumThreads(){ return mNumThreads; }
+    
+    // low-memory mode: channels run one after another, each streams its feature maps one by one
+    // into its conspicuity map, and every node is produced right before the first channel that
+    // needs it and released after the last one. frames are not pipelined in this mode.
+    void setLowMemoryEnabled(const bool enable);
+    inline bool isLowMemoryEnabled(){ return bLowMemory; }
+    
+    // CvMat bytes held at the peak of the last delivered frame, and matrices it allocated, on any
+    // thread (counted in the frame's own ofxSaliencyMapMemoryScope, see ofxSaliencyMapMemory.h)
+    inline size_t getPeakWorkingSetBytes(){ return mPeakWorkingSetBytes; }
+    inline size_t getFrameAllocations(){ return mFrameAllocations; }
+    
+    // float results (0-1) of the last delivered frame: the saliency map, and the normalized
+    // conspicuity map of each channel by channel name (unallocated when disabled or unknown)
+    void setFloatOutputEnabled(const bool enable);
+    inline bool isFloatOutputEnabled(){ return bFloatOutput; }
+    inline const ofFloatPixels & getSaliencyMapFloat(){ return mDstFloat; }
+    const ofFloatPixels & getConspicuityMap(const string & name);
+    
+    // output images without GL textures, for headless processing (ofAppNoWindow)
+    void setUseTexture(const bool use);
+    
     void setSourceImage(const ofImage srcImg);
     void setSourceImage(const ofPixels srcPix);
     void setWeightIntensity(const float val);
@@ -49,16 +136,159 @@ public:
     
 private:
     
-    float weightIntensity;
-    float weightColor;
-    float weightOrientation;
-    float weightMotion;
+    typedef ofxSaliencyMapNormTrace NormTrace;
+    typedef Poco::SharedPtr<ofxSaliencyMapSurroundTables> SurroundTablesPtr;
+    
+    // resolved frame graph of one revision: the nodes some valid channel needs, in
+    // dependency order, and the node indices read by each valid channel
+    struct GraphPlan {
+        
+        GraphPlan();
+        
+        bool valid;
+        unsigned long revision;
+        vector<ofxSaliencyMapNode *> nodes;
+        vector< vector<int> > dependencies;
+        vector<ofxSaliencyMapChannel *> channels;
+        vector< vector<int> > channelInputs;
+        int rgbi;	// index of the node the RGBI output planes come from, -1 for none
+        
+    };
+    
+    // intermediates and per-channel results of one frame, handed from the
+    // extraction stage to the channel and blend stages
+    struct FeatureFrame {
+        
+        FeatureFrame();
+        
+        CvSize size;
+        ofxSaliencyMapScaleSet scales;
+        SurroundTablesPtr surroundTables;
+        ofxSaliencyMapMemoryScope memory;	// bound to every thread working on the frame
+        unsigned long revision;	// graph revision the frame was built with
+        bool lowMemory;
+        bool floatOutput;
+        bool pipelined;	// conspicuity maps made by the caller, normalized and blended by the worker
+        
+        CvMat source;	// header of the source window, valid while the frame is extracted
+        CvRect window;
+        vector<ofxSaliencyMapNodeData> nodes;
+        int rgbi;
+        
+        vector<ofxSaliencyMapChannel *> channels;
+        vector< vector<int> > channelInputs;
+        vector<float> weights;
+        vector<CvMat *> CM;	// conspicuity map per channel (normalized unless pipelined), until blended
+        vector<NormTrace> traces;	// one per channel, then the blend
+        int pendingTasks;
+        
+        CvMat * SM;	// weighted sum of the conspicuity maps, then the range normalized result
+        
+        ofPixels pixR, pixG, pixB, pixI;
+        ofPixels pixDst;
+        ofFloatPixels pixDstFloat;
+        vector<ofFloatPixels> pixCM;
+        
+    };
+    
+    // one node or one channel of one frame
+    struct Task {
+        FeatureFrame * frame;
+        int node;	// index in frame->nodes, -1 for a channel task
+        int channel;
+    };
     
-    CvMat * prev_frame;
-    CvMat * GaborKernel0;
-    CvMat * GaborKernel45;
-    CvMat * GaborKernel90;
-    CvMat * GaborKernel135;
+    // scheduler thread: runs queued tasks of any frame
+    class TaskWorker : public ofThread {
+    public:
+        
+        TaskWorker();
+        
+        void setup(ofxSaliencyMap * owner);
+        
+    protected:
+        
+        void threadedFunction();
+        
+    private:
+        
+        ofxSaliencyMap * owner;
+        
+    };
+    
+    // runs combineFeatures() of one frame while the caller extracts the next
+    class PipelineWorker : public ofThread {
+    public:
+        
+        PipelineWorker();
+        
+        void setup(ofxSaliencyMap * owner);
+        FeatureFrame * exchange(FeatureFrame * next);	// waits for the running frame, then queues next
+        void stop();
+        
+    protected:
+        
+        void threadedFunction();
+        
+    private:
+        
+        ofxSaliencyMap * owner;
+        FeatureFrame * pending;
+        FeatureFrame * finished;
+        bool busy;
+        Poco::Condition condition;
+        
+    };
+    
+    bool bPipeline;
+    PipelineWorker mPipelineWorker;
+    
+    bool bLowMemory;
+    size_t mPeakWorkingSetBytes;
+    size_t mFrameAllocations;
+    
+    bool bFloatOutput;
+    ofFloatPixels mDstFloat;
+    vector<ofFloatPixels> mConspicuity;
+    vector<string> mConspicuityNames;
+    ofFloatPixels mNoMap;
+    
+    ofxSaliencyMapIntensityChannel mIntensityChannel;
+    ofxSaliencyMapColorChannel mColorChannel;
+    ofxSaliencyMapOrientationChannel mOrientationChannel;
+    ofxSaliencyMapMotionChannel mMotionChannel;
+    vector<ofxSaliencyMapChannel *> mChannels;
+    ofxSaliencyMapRGBINode mRGBINode;
+    ofxSaliencyMapIntensityPyramidNode mIntensityPyramidNode;
+    ofxSaliencyMapOpponencyNode mOpponencyNode;
+    ofxSaliencyMapMotionNode mMotionNode;
+    vector<ofxSaliencyMapNode *> mNodes;
+    vector<unsigned long> mNodeSerials;	// source image each node was last advanced to
+    unsigned long mGraphRevision;
+    GraphPlan mPlan;
+    
+    int mNumThreads;
+    vector<TaskWorker *> mTaskWorkers;
+    deque<Task> mTasks;
+    ofMutex mTaskMutex;
+    Poco::Condition mTaskCondition;
+    bool bStopTasks;
+    
+    unsigned long mSourceSerial;	// advanced once per setSourceImage()
+    
+    size_t mQueryPixels;
+    
+    // most recently used first; only touched by the thread calling createSaliencyMap() / querySaliency()
+    vector<SurroundTablesPtr> mSurroundTables;
+    
+    vector<NormTrace> mNormCache;
+    ofxSaliencyMapScaleSet mNormCacheScales;
+    unsigned long mNormCacheRevision;
+    ofxSaliencyMapScaleSet mScaleSet;
+    ofxSaliencyMapQueryNorm mQueryNorm;
+    
+    ofxSaliencyMapOrientation mOrientation;
+    ofxSaliencyMapOrientationMode mOrientationMode;
     ofImage mSrcImg;
     ofImage mDstImg;
     ofImage mR;
@@ -69,18 +299,41 @@ private:
     void initGabor();
     void initParams();
     
-    void SMExtractRGBI(IplImage * inputImage, CvMat * &R, CvMat * &G, CvMat * &B, CvMat * &I);
-    void IFMGetFM(CvMat * src, CvMat * dst[6]);
-    void CFMGetFM(CvMat * R, CvMat * G, CvMat * B, CvMat * RGFM[6], CvMat * BYFM[6]);
-    void OFMGetFM(CvMat * I, CvMat * dst[24]);
-    void MFMGetFM(CvMat * I, CvMat * dst_x[6], CvMat * dst_y[6]);
-    void normalizeFeatureMaps(CvMat * FM[6], CvMat * NFM[6], int width, int height, int num_maps);
-    CvMat * SMNormalization(CvMat * src);	// Itti normalization
-    CvMat * SMRangeNormalize(CvMat * src);	// dynamic range normalization
-    CvMat * ICMGetCM(CvMat *IFM[6], CvSize size);
-    CvMat * CCMGetCM(CvMat *CFM_RG[6], CvMat *CFM_BY[6], CvSize size);
-    CvMat * OCMGetCM(CvMat *OFM[24], CvSize size);
-    CvMat * MCMGetCM(CvMat *MFM_X[6], CvMat *MFM_Y[6], CvSize size);
+    ofxSaliencyMapScaleSet resolveScaleSet(CvSize size);
+    SurroundTablesPtr getSurroundTables(CvSize size, ofxSaliencyMapScaleSet scales);
+    void updatePlan();
+    bool planNode(const string & name, vector<string> & path, string & error);
+    void advanceNodes(CvMat * src);	// caller thread, once per source image
+    void buildFrame(FeatureFrame * frame, CvMat * src, CvRect window, ofxSaliencyMapScaleSet scales);
+    void produceNodes(FeatureFrame * frame);	// every node of the frame up front (caller thread)
+    void produceNode(FeatureFrame * frame, int index);
+    void requireNode(FeatureFrame * frame, int index);	// with its dependencies, unless already produced
+    void releaseNodes(FeatureFrame * frame, int after);	// outputs no channel after that one reads
+    void outputPlanes(FeatureFrame * frame);	// 8-bit RGBI output
+    void extractChannels(FeatureFrame * frame);	// conspicuity maps of a pipelined frame (caller thread)
+    void combineFeatures(FeatureFrame * frame);	// channels and blend
+    void outputFrame(FeatureFrame * frame);	// 8-bit saliency output
+    void publishFrame(FeatureFrame * frame);
+    void releaseFrame(FeatureFrame * frame);
+    
+    void runTasks(FeatureFrame * frame, const vector<Task> & ready, int total);	// until all of them are done
+    void runChannels(FeatureFrame * frame);
+    void runChannel(FeatureFrame * frame, int index);
+    void blendChannel(FeatureFrame * frame, int index);
+    bool runTask(bool wait);	// false once the scheduler stops
+    void startTaskWorkers();
+    void stopTaskWorkers();
+    
+    // channel context helpers
+    friend class ofxSaliencyMapChannelContext;
+    typedef ofxSaliencyMapSurroundTables SurroundTables;
+    void addConspicuity(CvMat * src, CvMat * accum, ofxSaliencyMapScaleSet scales, const SurroundTables * tables, NormTrace * trace);
+    void addConspicuityFromPyramid(CvMat * const pyramid[], CvMat * accum, ofxSaliencyMapScaleSet scales, const SurroundTables * tables, NormTrace * trace);
+    template<class Scales> void addConspicuity(CvMat * src, CvMat * accum, const SurroundTables * tables, NormTrace * trace);
+    template<class Scales> void streamCSD(CvMat * const pyramid[], CvMat * accum, const SurroundTables * tables, NormTrace * trace);
+    
+    CvMat * SMNormalization(CvMat * src, NormTrace * trace);	// Itti normalization
+    CvMat * SMRangeNormalize(CvMat * src, NormTrace * trace);	// dynamic range normalization
     
 };
 #endif
@@ -0,0 +1,166 @@
+/**
+ ofxSaliencyMapChannel.cpp https://github.com/TatsuyaOGth/ofxSaliencyMap
+
+ Copyright (c) 2014 TatsuyaOGth http://ogsn.org
+
+ This software is released under the MIT License.
+ http://opensource.org/licenses/mit-license.php
+ */
+#include "ofxSaliencyMap.h"
+
+ofxSaliencyMapChannel::ofxSaliencyMapChannel(const string & name, const float weight)
+{
+    mName = name;
+    mWeight = weight;
+}
+
+ofxSaliencyMapChannel::~ofxSaliencyMapChannel()
+{
+}
+
+void ofxSaliencyMapChannel::addInput(const string & name)
+{
+    if (find(mInputs.begin(), mInputs.end(), name) == mInputs.end()) mInputs.push_back(name);
+}
+
+void ofxSaliencyMapChannel::setWeight(const float val)
+{
+    mWeight = val;
+}
+
+//////////////////////////////////////////////////////////////////
+// Intensity
+//////////////////////////////////////////////////////////////////
+ofxSaliencyMapIntensityChannel::ofxSaliencyMapIntensityChannel()
+: ofxSaliencyMapChannel("intensity", OFXSALIENCYMAP_DEF_WEIGHT_INTENSITY)
+{
+    addInput(OFXSALIENCYMAP_NODE_INTENSITY_PYRAMID);
+}
+
+CvMat * ofxSaliencyMapIntensityChannel::createConspicuityMap(ofxSaliencyMapChannelContext & context)
+{
+
+    CvMat * CM = context.createMap();
+    const vector<CvMat *> & pyramid = context.getInput(OFXSALIENCYMAP_NODE_INTENSITY_PYRAMID);
+    if (pyramid.size() == context.getScaleInfo().levels) context.addConspicuityFromPyramid(&pyramid[0], CM);
+    return CM;
+
+}
+
+//////////////////////////////////////////////////////////////////
+// Color
+//////////////////////////////////////////////////////////////////
+ofxSaliencyMapColorChannel::ofxSaliencyMapColorChannel()
+: ofxSaliencyMapChannel("color", OFXSALIENCYMAP_DEF_WEIGHT_COLOR)
+{
+    addInput(OFXSALIENCYMAP_NODE_OPPONENCY);
+}
+
+CvMat * ofxSaliencyMapColorChannel::createConspicuityMap(ofxSaliencyMapChannelContext & context)
+{
+
+    CvMat * CM = context.createMap();
+    const vector<CvMat *> & opponency = context.getInput(OFXSALIENCYMAP_NODE_OPPONENCY);
+    for(int i=0; i<opponency.size(); i++) context.addConspicuity(opponency[i], CM);
+    return CM;
+
+}
+
+//////////////////////////////////////////////////////////////////
+// Orientation
+//////////////////////////////////////////////////////////////////
+ofxSaliencyMapOrientationChannel::ofxSaliencyMapOrientationChannel()
+: ofxSaliencyMapChannel("orientation", OFXSALIENCYMAP_DEF_WEIGHT_ORIENTATION)
+{
+    addInput(OFXSALIENCYMAP_NODE_INTENSITY_PYRAMID);
+}
+
+CvMat * ofxSaliencyMapOrientationChannel::createConspicuityMap(ofxSaliencyMapChannelContext & context)
+{
+
+    const vector<CvMat *> & pyramid = context.getInput(OFXSALIENCYMAP_NODE_INTENSITY_PYRAMID);
+    if (pyramid.size() != context.getScaleInfo().levels) return context.createMap();
+
+    // every scale set is its own instantiation, so the level loops have constant bounds
+    switch (context.getScaleSet()) {
+        case OFXSALIENCYMAP_SCALES_VGA: return createConspicuityMap<ofxSaliencyMapScalesVGA>(context, &pyramid[0]);
+        case OFXSALIENCYMAP_SCALES_QVGA: return createConspicuityMap<ofxSaliencyMapScalesQVGA>(context, &pyramid[0]);
+        case OFXSALIENCYMAP_SCALES_QQVGA: return createConspicuityMap<ofxSaliencyMapScalesQQVGA>(context, &pyramid[0]);
+        default: return createConspicuityMap<ofxSaliencyMapScalesDefault>(context, &pyramid[0]);
+    }
+
+}
+
+template<class Scales>
+CvMat * ofxSaliencyMapOrientationChannel::createConspicuityMap(ofxSaliencyMapChannelContext & context, CvMat * const pyramid[])
+{
+
+    ofxSaliencyMapOrientation & engine = context.getOrientationEngine();
+    int num_angles = engine.getNumOrientations();
+
+    // Gabor filter the center and surround levels of the shared intensity pyramid
+    CvMat* gabor[OFXSALIENCYMAP_MAX_ORIENTATIONS][Scales::LEVELS];
+    for(int j=Scales::CENTER_BEGIN; j<Scales::LEVELS; j++)
+    {
+
+        CvMat* levelOutput[OFXSALIENCYMAP_MAX_ORIENTATIONS];
+        engine.filter(pyramid[j], levelOutput);
+        for(int a=0; a<num_angles; a++) gabor[a][j] = levelOutput[a];
+
+    }
+
+    // each angle is normalized as a whole before it is summed up
+    CvMat * CM = context.createMap();
+    for(int a=0; a<num_angles; a++)
+    {
+
+        CvMat* angleCM = context.createMap();
+        context.addConspicuityFromPyramid(gabor[a], angleCM);
+        for(int j=Scales::CENTER_BEGIN; j<Scales::LEVELS; j++) SMReleaseMat(&gabor[a][j]);
+        CvMat* angleCM_norm = context.normalize(angleCM);
+        cvAdd(angleCM_norm, CM, CM);
+        SMReleaseMat(&angleCM);
+        SMReleaseMat(&angleCM_norm);
+
+    }
+    return CM;
+
+}
+
+//////////////////////////////////////////////////////////////////
+// Motion
+//////////////////////////////////////////////////////////////////
+ofxSaliencyMapMotionChannel::ofxSaliencyMapMotionChannel()
+: ofxSaliencyMapChannel("motion", OFXSALIENCYMAP_DEF_WEIGHT_MOTION)
+{
+    addInput(OFXSALIENCYMAP_NODE_MOTION);
+}
+
+CvMat * ofxSaliencyMapMotionChannel::createConspicuityMap(ofxSaliencyMapChannelContext & context)
+{
+
+    // current and previous frame, the latter missing on the first frame and after a resolution change
+    const vector<CvMat *> & frames = context.getInput(OFXSALIENCYMAP_NODE_MOTION);
+    CvSize size = context.getSize();
+
+    // obtain optical flow information
+    CvMat* flowx = SMCreateMat(size.height, size.width, CV_32FC1);
+    CvMat* flowy = SMCreateMat(size.height, size.width, CV_32FC1);
+    cvSetZero(flowx);
+    cvSetZero(flowy);
+    if(frames.size() >= 2)
+    {
+
+        cvCalcOpticalFlowLK(frames[1], frames[0], cvSize(7,7), flowx, flowy);
+
+    }
+
+    // one flow component at a time
+    CvMat * CM = context.createMap();
+    context.addConspicuity(flowx, CM);
+    SMReleaseMat(&flowx);
+    context.addConspicuity(flowy, CM);
+    SMReleaseMat(&flowy);
+    return CM;
+
+}
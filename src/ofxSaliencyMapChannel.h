@@ -0,0 +1,163 @@
+/**
+ ofxSaliencyMapChannel.h https://github.com/TatsuyaOGth/ofxSaliencyMap
+
+ Copyright (c) 2014 TatsuyaOGth http://ogsn.org
+
+ This software is released under the MIT License.
+ http://opensource.org/licenses/mit-license.php
+ */
+#ifndef _OFX_SALIENCY_MAP_CHANNEL_H_
+#define _OFX_SALIENCY_MAP_CHANNEL_H_
+
+#include "ofMain.h"
+#include "ofxCv.h"
+#include "ofxSaliencyMapOrientation.h"
+#include "ofxSaliencyMapMemory.h"
+#include "ofxSaliencyMapScales.h"
+#include "ofxSaliencyMapNode.h"
+
+class ofxSaliencyMap;
+
+// statistics of one SMNormalization() call
+struct ofxSaliencyMapNormStats {
+    double minVal;
+    double maxVal;
+    double coeff;
+};
+
+// normalization statistics of one channel of a frame, in call order; replayed by sparse queries
+struct ofxSaliencyMapNormTrace {
+
+    ofxSaliencyMapNormTrace() : cursor(0), replay(false) {}
+
+    vector<ofxSaliencyMapNormStats> stats;
+    size_t cursor;
+    bool replay;
+
+};
+
+// source indices and weights of one axis, as cvResize(CV_INTER_LINEAR) samples them
+struct ofxSaliencyMapLinearTable {
+
+    void setup(int dst_size, int src_size);
+
+    vector<int> i0;
+    vector<int> i1;
+    vector<float> w;
+
+};
+
+// bilinear sampling tables of every center-surround pair of one pyramid geometry, indexed
+// like the feature maps ((center - centerBegin) * 2 + surround delta). built once per frame
+// size and scale set, and shared read-only by all frames and query windows of that size.
+struct ofxSaliencyMapSurroundTables {
+
+    void setup(CvSize size, ofxSaliencyMapScaleSet scales);	// levels halved like the Gaussian pyramid
+    void setup(CvMat * const pyramid[], const ofxSaliencyMapScaleInfo & info);	// levels of an existing pyramid (from centerBegin)
+    void build();
+    bool matches(CvMat * const pyramid[]) const;
+
+    CvSize size;
+    ofxSaliencyMapScaleSet scales;
+    ofxSaliencyMapScaleInfo info;
+    CvSize levels[OFXSALIENCYMAP_MAX_PYRAMID_LEVELS];
+    ofxSaliencyMapLinearTable x[OFXSALIENCYMAP_MAX_FEATURE_MAPS];
+    ofxSaliencyMapLinearTable y[OFXSALIENCYMAP_MAX_FEATURE_MAPS];
+
+};
+
+// what a channel sees of the frame it works on: the outputs of the nodes it declared as
+// inputs, and helpers that run the shared pyramid and
+// center-surround stages with the frame's scale set, and record (or replay) their
+// normalization statistics in the channel's own trace.
+class ofxSaliencyMapChannelContext {
+public:
+
+    ofxSaliencyMapChannelContext(ofxSaliencyMap * owner, const vector<ofxSaliencyMapNodeData> & nodes, CvSize size, ofxSaliencyMapScaleSet scales,
+                                 const ofxSaliencyMapSurroundTables * tables, ofxSaliencyMapNormTrace * trace);
+
+    // outputs of one of the channel's inputs (see ofxSaliencyMapNode.h for the built-in ones)
+    const vector<CvMat *> & getInput(const string & name);
+    inline CvSize getSize(){ return size; }
+    inline ofxSaliencyMapScaleSet getScaleSet(){ return scales; }
+    ofxSaliencyMapScaleInfo getScaleInfo();
+    ofxSaliencyMapOrientation & getOrientationEngine();
+
+    // zeroed CV_32FC1 map of the frame size
+    CvMat * createMap();
+    // Gaussian pyramid of src, center-surround maps, each normalized and added to accum
+    void addConspicuity(CvMat * src, CvMat * accum);
+    // the same from an existing pyramid (only levels from getScaleInfo().centerBegin are read)
+    void addConspicuityFromPyramid(CvMat * const pyramid[], CvMat * accum);
+    // Itti normalization into a new map
+    CvMat * normalize(CvMat * src);
+
+private:
+
+    ofxSaliencyMap * owner;
+    const vector<ofxSaliencyMapNodeData> & nodes;
+    CvSize size;
+    ofxSaliencyMapScaleSet scales;
+    const ofxSaliencyMapSurroundTables * tables;
+    ofxSaliencyMapNormTrace * trace;
+
+};
+
+// one feature channel of the saliency map.
+//
+// createConspicuityMap() runs on a scheduler thread, concurrently with the other
+// channels of the frame: it may only read the context and its inputs, and must keep
+// per-frame state out of the channel object. state across frames (previous frames for
+// flicker, a depth map handed in by the application) belongs in a node the channel reads,
+// see ofxSaliencyMapNode. the returned map (frame size, CV_32FC1, allocated with
+// SMCreateMat) is normalized and blended with the weight.
+class ofxSaliencyMapChannel {
+public:
+
+    ofxSaliencyMapChannel(const string & name, const float weight);
+    virtual ~ofxSaliencyMapChannel();
+
+    virtual CvMat * createConspicuityMap(ofxSaliencyMapChannelContext & context) = 0;
+
+    void addInput(const string & name);	// a node the channel reads; register inputs before adding the channel
+    void setWeight(const float val);
+    inline float getWeight(){ return mWeight; }
+    inline const string & getName(){ return mName; }
+    inline const vector<string> & getInputs(){ return mInputs; }
+
+protected:
+
+    string mName;
+    vector<string> mInputs;
+    float mWeight;
+
+};
+
+// built-in channels
+class ofxSaliencyMapIntensityChannel : public ofxSaliencyMapChannel {
+public:
+    ofxSaliencyMapIntensityChannel();
+    CvMat * createConspicuityMap(ofxSaliencyMapChannelContext & context);
+};
+
+class ofxSaliencyMapColorChannel : public ofxSaliencyMapChannel {
+public:
+    ofxSaliencyMapColorChannel();
+    CvMat * createConspicuityMap(ofxSaliencyMapChannelContext & context);
+};
+
+class ofxSaliencyMapOrientationChannel : public ofxSaliencyMapChannel {
+public:
+    ofxSaliencyMapOrientationChannel();
+    CvMat * createConspicuityMap(ofxSaliencyMapChannelContext & context);
+private:
+    template<class Scales> CvMat * createConspicuityMap(ofxSaliencyMapChannelContext & context, CvMat * const pyramid[]);
+};
+
+class ofxSaliencyMapMotionChannel : public ofxSaliencyMapChannel {
+public:
+    ofxSaliencyMapMotionChannel();
+    CvMat * createConspicuityMap(ofxSaliencyMapChannelContext & context);
+};
+
+#endif
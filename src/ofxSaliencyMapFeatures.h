@@ -0,0 +1,33 @@
+/**
+ ofxSaliencyMapFeatures.h https://github.com/TatsuyaOGth/ofxSaliencyMap
+
+ Copyright (c) 2014 TatsuyaOGth http://ogsn.org
+
+ This software is released under the MIT License.
+ http://opensource.org/licenses/mit-license.php
+ */
+#ifndef _OFX_SALIENCY_MAP_FEATURES_H_
+#define _OFX_SALIENCY_MAP_FEATURES_H_
+
+#include "ofMain.h"
+#include "ofxCv.h"
+#include "ofxSaliencyMapScales.h"
+
+// feature extraction stages shared by ofxSaliencyMap and the built-in nodes
+// (defined in ofxSaliencyMap.cpp). all maps are allocated with SMCreateMat
+
+ofxSaliencyMapScaleInfo SMScaleInfo(ofxSaliencyMapScaleSet scales);
+
+// R, G, B and I planes (CV_32FC1, 0-1) of 8-bit 3-channel pixels
+void SMExtractRGBI(CvMat* inputImage, CvMat* &R, CvMat* &G, CvMat* &B, CvMat* &I);
+// 8-bit intensity of 8-bit 3-channel pixels
+CvMat* SMExtractI8U(CvMat* src);
+
+// Gaussian pyramid of src with the depth of the scale set; returns the number of levels
+int FMCreateGaussianPyr(CvMat* src, CvMat* dst[], ofxSaliencyMapScaleSet scales);
+
+// per-pixel Max(R,G,B), clamped away from 0, and the RG (or BY) opponency divided by it
+void CFMMaxRGB(CvMat* R, CvMat* G, CvMat* B, CvMat* RGBMax);
+void CFMOpponency(CvMat* R, CvMat* G, CvMat* B, CvMat* RGBMax, CvMat* dst, bool blueYellow);
+
+#endif
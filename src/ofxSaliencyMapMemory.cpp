@@ -0,0 +1,179 @@
+/**
+ ofxSaliencyMapMemory.cpp https://github.com/TatsuyaOGth/ofxSaliencyMap
+
+ Copyright (c) 2014 TatsuyaOGth http://ogsn.org
+
+ This software is released under the MIT License.
+ http://opensource.org/licenses/mit-license.php
+ */
+#include "ofxSaliencyMapMemory.h"
+#include "Poco/ThreadLocal.h"
+
+// the scope bound to one thread, and what the thread created and released since it was bound.
+// counted without a lock, and charged to the scope, its parents and the process totals when
+// the binding ends (or another binding starts on the thread)
+struct SMThreadMemory {
+
+    SMThreadMemory() : scope(NULL), bytes(0), peakBytes(0), mats(0), allocations(0) {}
+
+    ofxSaliencyMapMemoryScope * scope;
+    ptrdiff_t bytes;
+    ptrdiff_t peakBytes;	// highest bytes since the binding started
+    ptrdiff_t mats;
+    size_t allocations;
+
+};
+
+static ofMutex SMMemoryMutex;
+static ofxSaliencyMapMemoryStats SMMemory = { 0, 0, 0, 0 };
+static Poco::ThreadLocal<SMThreadMemory> SMBoundMemory;
+
+static size_t SMMatBytes(const CvMat * mat)
+{
+    return (size_t)mat->step * mat->rows;
+}
+
+// the counters of the calling thread while a scope is bound to it, else the process totals
+static void SMTrackMat(const CvMat * mat, int sign)
+{
+    ptrdiff_t bytes = sign * (ptrdiff_t)SMMatBytes(mat);
+
+    SMThreadMemory & local = *SMBoundMemory;
+    if (local.scope != NULL) {
+        local.bytes += bytes;
+        local.peakBytes = MAX(local.peakBytes, local.bytes);
+        local.mats += sign;
+        if (sign > 0) local.allocations++;
+        return;
+    }
+
+    SMMemoryMutex.lock();
+    SMMemory.currentBytes += bytes;
+    SMMemory.peakBytes = MAX(SMMemory.peakBytes, SMMemory.currentBytes);
+    SMMemory.liveMats += sign;
+    if (sign > 0) SMMemory.allocations++;
+    SMMemoryMutex.unlock();
+}
+
+// charges the counters of the calling thread to the process totals, then to the bound scope
+// and its parents, and restarts them
+void SMMergeThreadMemory()
+{
+    SMThreadMemory & local = *SMBoundMemory;
+    if (local.scope == NULL || (local.allocations == 0 && local.mats == 0)) return;
+
+    SMMemoryMutex.lock();
+    SMMemory.peakBytes = MAX(SMMemory.peakBytes, SMMemory.currentBytes + local.peakBytes);
+    SMMemory.currentBytes += local.bytes;
+    SMMemory.liveMats += local.mats;
+    SMMemory.allocations += local.allocations;
+    for (ofxSaliencyMapMemoryScope * scope = local.scope; scope != NULL; scope = scope->parent) {
+        scope->peakBytes = MAX(scope->peakBytes, scope->bytes + local.peakBytes);
+        scope->bytes += local.bytes;
+        scope->mats += local.mats;
+        scope->allocations += local.allocations;
+    }
+    SMMemoryMutex.unlock();
+
+    local.bytes = 0;
+    local.peakBytes = 0;
+    local.mats = 0;
+    local.allocations = 0;
+}
+
+CvMat * SMCreateMat(int rows, int cols, int type)
+{
+    CvMat * mat = cvCreateMat(rows, cols, type);
+    SMTrackMat(mat, 1);
+    return mat;
+}
+
+CvMat * SMCloneMat(const CvMat * src)
+{
+    CvMat * mat = cvCloneMat(src);
+    SMTrackMat(mat, 1);
+    return mat;
+}
+
+void SMReleaseMat(CvMat ** mat)
+{
+    if (mat == NULL || *mat == NULL) return;
+
+    SMTrackMat(*mat, -1);
+    cvReleaseMat(mat);
+}
+
+ofxSaliencyMapMemoryStats SMGetMemoryStats()
+{
+    SMMemoryMutex.lock();
+    ofxSaliencyMapMemoryStats stats = SMMemory;
+    SMMemoryMutex.unlock();
+    return stats;
+}
+
+void SMResetPeakBytes()
+{
+    SMMemoryMutex.lock();
+    SMMemory.peakBytes = SMMemory.currentBytes;
+    SMMemory.allocations = 0;
+    SMMemoryMutex.unlock();
+}
+
+//////////////////////////////////////////////////////////////////
+// Memory Scope
+//////////////////////////////////////////////////////////////////
+ofxSaliencyMapMemoryScope::ofxSaliencyMapMemoryScope(ofxSaliencyMapMemoryScope * parent)
+{
+    this->parent = parent;
+    bytes = 0;
+    peakBytes = 0;
+    mats = 0;
+    allocations = 0;
+}
+
+void ofxSaliencyMapMemoryScope::setParent(ofxSaliencyMapMemoryScope * parent)
+{
+    SMMemoryMutex.lock();
+    this->parent = parent;
+    SMMemoryMutex.unlock();
+}
+
+ofxSaliencyMapMemoryStats ofxSaliencyMapMemoryScope::getStats()
+{
+    SMMemoryMutex.lock();
+    ofxSaliencyMapMemoryStats stats;
+    stats.currentBytes = MAX(bytes, (ptrdiff_t)0);
+    stats.peakBytes = MAX(peakBytes, (ptrdiff_t)0);
+    stats.liveMats = MAX(mats, (ptrdiff_t)0);
+    stats.allocations = allocations;
+    SMMemoryMutex.unlock();
+    return stats;
+}
+
+void ofxSaliencyMapMemoryScope::reset()
+{
+    SMMemoryMutex.lock();
+    bytes = 0;
+    peakBytes = 0;
+    mats = 0;
+    allocations = 0;
+    SMMemoryMutex.unlock();
+}
+
+ofxSaliencyMapMemoryBinding::ofxSaliencyMapMemoryBinding(ofxSaliencyMapMemoryScope * scope)
+{
+    SMMergeThreadMemory();
+    previous = SMBoundMemory->scope;
+    SMBoundMemory->scope = scope;
+}
+
+ofxSaliencyMapMemoryBinding::~ofxSaliencyMapMemoryBinding()
+{
+    SMMergeThreadMemory();
+    SMBoundMemory->scope = previous;
+}
+
+ofxSaliencyMapMemoryScope * SMGetMemoryScope()
+{
+    return SMBoundMemory->scope;
+}
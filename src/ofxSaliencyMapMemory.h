@@ -0,0 +1,85 @@
+/**
+ ofxSaliencyMapMemory.h https://github.com/TatsuyaOGth/ofxSaliencyMap
+
+ Copyright (c) 2014 TatsuyaOGth http://ogsn.org
+
+ This software is released under the MIT License.
+ http://opensource.org/licenses/mit-license.php
+ */
+#ifndef _OFX_SALIENCY_MAP_MEMORY_H_
+#define _OFX_SALIENCY_MAP_MEMORY_H_
+
+#include "ofMain.h"
+#include "ofxCv.h"
+
+// bytes held by the CvMat buffers of all ofxSaliencyMap instances in the process,
+// or charged to one ofxSaliencyMapMemoryScope
+struct ofxSaliencyMapMemoryStats {
+    size_t currentBytes;	// live matrix data
+    size_t peakBytes;		// highest currentBytes since the last reset
+    size_t liveMats;		// matrices not yet released
+    size_t allocations;		// matrices created since the last reset
+};
+
+// counted replacements of cvCreateMat / cvCloneMat / cvReleaseMat
+CvMat * SMCreateMat(int rows, int cols, int type);
+CvMat * SMCloneMat(const CvMat * src);
+void SMReleaseMat(CvMat ** mat);
+
+// process totals. SMResetPeakBytes() restarts peakBytes and allocations for the whole process;
+// ofxSaliencyMap never calls it, work of one instance or one frame is measured with a scope
+ofxSaliencyMapMemoryStats SMGetMemoryStats();
+void SMResetPeakBytes();
+
+// the matrices created and released by the threads a scope is bound to, while it is bound.
+// ofxSaliencyMap binds a scope per frame (and per query window) to every thread working on
+// it. a scope also charges its parent, which must outlive it: a frame's parent is the scope
+// bound to the thread calling createSaliencyMap() / querySaliency(), unless the frame is
+// pipelined and finishes in a later call. currentBytes and liveMats count creations minus
+// releases within the scope, so releasing older matrices can take them down to 0.
+// each thread counts without a lock, and charges a scope (and the process totals) when its
+// binding ends: getStats() leaves out bindings still open. peakBytes is the highest peak of
+// one binding on top of the bytes already charged, so peaks of threads working at the same
+// time are not added up.
+class ofxSaliencyMapMemoryScope {
+public:
+
+    ofxSaliencyMapMemoryScope(ofxSaliencyMapMemoryScope * parent = NULL);
+
+    void setParent(ofxSaliencyMapMemoryScope * parent);
+    ofxSaliencyMapMemoryStats getStats();
+    void reset();
+
+private:
+
+    friend void SMMergeThreadMemory();
+
+    ofxSaliencyMapMemoryScope * parent;
+    ptrdiff_t bytes;
+    ptrdiff_t peakBytes;
+    ptrdiff_t mats;
+    size_t allocations;
+
+    // not copyable: threads may still be bound to it
+    ofxSaliencyMapMemoryScope(const ofxSaliencyMapMemoryScope &);
+    ofxSaliencyMapMemoryScope & operator=(const ofxSaliencyMapMemoryScope &);
+
+};
+
+// binds a scope to the calling thread for its lifetime, then restores the previous binding
+class ofxSaliencyMapMemoryBinding {
+public:
+
+    ofxSaliencyMapMemoryBinding(ofxSaliencyMapMemoryScope * scope);
+    ~ofxSaliencyMapMemoryBinding();
+
+private:
+
+    ofxSaliencyMapMemoryScope * previous;
+
+};
+
+// scope bound to the calling thread, NULL for none
+ofxSaliencyMapMemoryScope * SMGetMemoryScope();
+
+#endif
@@ -0,0 +1,176 @@
+/**
+ ofxSaliencyMapNode.cpp https://github.com/TatsuyaOGth/ofxSaliencyMap
+
+ Copyright (c) 2014 TatsuyaOGth http://ogsn.org
+
+ This software is released under the MIT License.
+ http://opensource.org/licenses/mit-license.php
+ */
+#include "ofxSaliencyMapNode.h"
+#include "ofxSaliencyMapFeatures.h"
+
+ofxSaliencyMapNodeData::ofxSaliencyMapNodeData()
+{
+    node = NULL;
+    produced = false;
+    pendingDependencies = 0;
+    lastUse = -1;
+}
+
+const vector<CvMat *> & SMGetNodeOutputs(const vector<ofxSaliencyMapNodeData> & nodes, const string & name)
+{
+    static const vector<CvMat *> none;
+    for (int i=0; i<nodes.size(); i++) {
+        if (nodes[i].node->getName() == name) return nodes[i].outputs;
+    }
+    return none;
+}
+
+ofxSaliencyMapNodeContext::ofxSaliencyMapNodeContext(const vector<ofxSaliencyMapNodeData> & nodes, CvMat * source, CvRect window,
+                                                     ofxSaliencyMapScaleSet scales, vector<CvMat *> & outputs)
+: nodes(nodes), source(source), window(window), scales(scales), outputs(outputs)
+{
+}
+
+ofxSaliencyMapScaleInfo ofxSaliencyMapNodeContext::getScaleInfo()
+{
+    return SMScaleInfo(scales);
+}
+
+const vector<CvMat *> & ofxSaliencyMapNodeContext::getInput(const string & name)
+{
+    return SMGetNodeOutputs(nodes, name);
+}
+
+void ofxSaliencyMapNodeContext::addOutput(CvMat * mat)
+{
+    outputs.push_back(mat);
+}
+
+ofxSaliencyMapNode::ofxSaliencyMapNode(const string & name)
+{
+    mName = name;
+}
+
+ofxSaliencyMapNode::~ofxSaliencyMapNode()
+{
+}
+
+void ofxSaliencyMapNode::advance(CvMat * source)
+{
+}
+
+void ofxSaliencyMapNode::addDependency(const string & name)
+{
+    if (find(mDependencies.begin(), mDependencies.end(), name) == mDependencies.end()) mDependencies.push_back(name);
+}
+
+//////////////////////////////////////////////////////////////////
+// RGBI
+//////////////////////////////////////////////////////////////////
+ofxSaliencyMapRGBINode::ofxSaliencyMapRGBINode()
+: ofxSaliencyMapNode(OFXSALIENCYMAP_NODE_RGBI)
+{
+}
+
+void ofxSaliencyMapRGBINode::produce(ofxSaliencyMapNodeContext & context)
+{
+
+    CvMat *R, *G, *B, *I;
+    SMExtractRGBI(context.getSource(), R, G, B, I);
+    context.addOutput(R);
+    context.addOutput(G);
+    context.addOutput(B);
+    context.addOutput(I);
+
+}
+
+//////////////////////////////////////////////////////////////////
+// Intensity Pyramid
+//////////////////////////////////////////////////////////////////
+ofxSaliencyMapIntensityPyramidNode::ofxSaliencyMapIntensityPyramidNode()
+: ofxSaliencyMapNode(OFXSALIENCYMAP_NODE_INTENSITY_PYRAMID)
+{
+    addDependency(OFXSALIENCYMAP_NODE_RGBI);
+}
+
+void ofxSaliencyMapIntensityPyramidNode::produce(ofxSaliencyMapNodeContext & context)
+{
+
+    const vector<CvMat *> & rgbi = context.getInput(OFXSALIENCYMAP_NODE_RGBI);
+    if (rgbi.size() < 4) return;
+
+    CvMat* pyramid[OFXSALIENCYMAP_MAX_PYRAMID_LEVELS];
+    int levels = FMCreateGaussianPyr(rgbi[3], pyramid, context.getScaleSet());
+    for (int i=0; i<levels; i++) context.addOutput(pyramid[i]);
+
+}
+
+//////////////////////////////////////////////////////////////////
+// Opponency
+//////////////////////////////////////////////////////////////////
+ofxSaliencyMapOpponencyNode::ofxSaliencyMapOpponencyNode()
+: ofxSaliencyMapNode(OFXSALIENCYMAP_NODE_OPPONENCY)
+{
+    addDependency(OFXSALIENCYMAP_NODE_RGBI);
+}
+
+void ofxSaliencyMapOpponencyNode::produce(ofxSaliencyMapNodeContext & context)
+{
+
+    const vector<CvMat *> & rgbi = context.getInput(OFXSALIENCYMAP_NODE_RGBI);
+    if (rgbi.size() < 4) return;
+
+    int height = context.getSize().height;
+    int width = context.getSize().width;
+    CvMat* RGBMax = SMCreateMat(height, width, CV_32FC1);
+    CvMat* RG = SMCreateMat(height, width, CV_32FC1);
+    CvMat* BY = SMCreateMat(height, width, CV_32FC1);
+    CFMMaxRGB(rgbi[0], rgbi[1], rgbi[2], RGBMax);
+    CFMOpponency(rgbi[0], rgbi[1], rgbi[2], RGBMax, RG, false);
+    CFMOpponency(rgbi[0], rgbi[1], rgbi[2], RGBMax, BY, true);
+    SMReleaseMat(&RGBMax);
+    context.addOutput(RG);
+    context.addOutput(BY);
+
+}
+
+//////////////////////////////////////////////////////////////////
+// Motion
+//////////////////////////////////////////////////////////////////
+ofxSaliencyMapMotionNode::ofxSaliencyMapMotionNode()
+: ofxSaliencyMapNode(OFXSALIENCYMAP_NODE_MOTION)
+{
+    prev_frame = NULL;
+    cur_frame = NULL;
+}
+
+ofxSaliencyMapMotionNode::~ofxSaliencyMapMotionNode()
+{
+    SMReleaseMat(&prev_frame);
+    SMReleaseMat(&cur_frame);
+}
+
+void ofxSaliencyMapMotionNode::advance(CvMat * source)
+{
+
+    CvMat * I8U = SMExtractI8U(source);
+    SMReleaseMat(&prev_frame);
+    prev_frame = cur_frame;
+    cur_frame = I8U;
+
+    // a resolution change restarts the motion pair instead of keeping a frame no window can use
+    if (prev_frame != NULL && (prev_frame->cols != I8U->cols || prev_frame->rows != I8U->rows)) SMReleaseMat(&prev_frame);
+
+}
+
+void ofxSaliencyMapMotionNode::produce(ofxSaliencyMapNodeContext & context)
+{
+
+    // the same window of the current and the previous source image
+    if (cur_frame == NULL) return;
+    CvMat windowHeader;
+    context.addOutput(SMCloneMat(cvGetSubRect(cur_frame, &windowHeader, context.getWindow())));
+    if (prev_frame != NULL) context.addOutput(SMCloneMat(cvGetSubRect(prev_frame, &windowHeader, context.getWindow())));
+
+}
@@ -0,0 +1,139 @@
+/**
+ ofxSaliencyMapNode.h https://github.com/TatsuyaOGth/ofxSaliencyMap
+
+ Copyright (c) 2014 TatsuyaOGth http://ogsn.org
+
+ This software is released under the MIT License.
+ http://opensource.org/licenses/mit-license.php
+ */
+#ifndef _OFX_SALIENCY_MAP_NODE_H_
+#define _OFX_SALIENCY_MAP_NODE_H_
+
+#include "ofMain.h"
+#include "ofxCv.h"
+#include "ofxSaliencyMapMemory.h"
+#include "ofxSaliencyMapScales.h"
+
+class ofxSaliencyMapNode;
+
+// names of the built-in nodes
+static const char * const OFXSALIENCYMAP_NODE_RGBI              = "rgbi";	// R, G, B and I planes (0-1)
+static const char * const OFXSALIENCYMAP_NODE_INTENSITY_PYRAMID = "intensityPyramid";	// Gaussian pyramid of I, one output per level
+static const char * const OFXSALIENCYMAP_NODE_OPPONENCY         = "opponency";	// RG and BY opponency planes
+static const char * const OFXSALIENCYMAP_NODE_MOTION            = "motion";	// 8-bit intensity of the current and, if any, the previous source image
+
+// one node of one frame (or query window): its outputs, and its place in the frame's schedule
+struct ofxSaliencyMapNodeData {
+
+    ofxSaliencyMapNodeData();
+
+    ofxSaliencyMapNode * node;
+    vector<CvMat *> outputs;
+    bool produced;
+
+    // set up by ofxSaliencyMap
+    vector<int> dependencies;	// indices of the nodes it reads
+    vector<int> dependents;	// indices of the nodes reading it
+    int pendingDependencies;
+    int lastUse;	// last channel (in blend order) that needs the outputs, -1 for none
+
+};
+
+// outputs of the node of that name among the nodes of a frame (empty if there is none)
+const vector<CvMat *> & SMGetNodeOutputs(const vector<ofxSaliencyMapNodeData> & nodes, const string & name);
+
+// what a node sees of the frame (or query window) it produces its outputs for
+class ofxSaliencyMapNodeContext {
+public:
+
+    ofxSaliencyMapNodeContext(const vector<ofxSaliencyMapNodeData> & nodes, CvMat * source, CvRect window,
+                              ofxSaliencyMapScaleSet scales, vector<CvMat *> & outputs);
+
+    inline CvMat * getSource(){ return source; }	// 8-bit 3-channel pixels of the frame or window
+    inline CvRect getWindow(){ return window; }	// position of those pixels in the source image
+    inline CvSize getSize(){ return cvSize(window.width, window.height); }
+    inline ofxSaliencyMapScaleSet getScaleSet(){ return scales; }
+    ofxSaliencyMapScaleInfo getScaleInfo();
+
+    // outputs of one of the node's dependencies
+    const vector<CvMat *> & getInput(const string & name);
+    // appends an output (created with SMCreateMat / SMCloneMat); the frame releases it
+    // after the last channel that reads it
+    void addOutput(CvMat * mat);
+
+private:
+
+    const vector<ofxSaliencyMapNodeData> & nodes;
+    CvMat * source;
+    CvRect window;
+    ofxSaliencyMapScaleSet scales;
+    vector<CvMat *> & outputs;
+
+};
+
+// one named intermediate of the frame graph.
+//
+// channels and other nodes read a node by its name. every node some registered channel
+// needs is produced once per frame, after the nodes it depends on, however many
+// channels read it; independent nodes are produced concurrently on the scheduler threads.
+//
+// state across frames: produce() may run on any scheduler thread and must only read
+// the node object. a node that needs history (previous frames, running averages, a map
+// handed in by the application such as depth) keeps it in the node and updates it in
+// advance(), which is called once per new source image, while some channel reads the
+// node, on the thread calling ofxSaliencyMap::createSaliencyMap() / querySaliency(),
+// before any produce() of that image. every produce() of an image has returned before those calls return, so advance()
+// never overlaps a produce() of the node. channels stay stateless: a channel with history
+// (flicker, motion) declares such a node as its input.
+class ofxSaliencyMapNode {
+public:
+
+    ofxSaliencyMapNode(const string & name);
+    virtual ~ofxSaliencyMapNode();
+
+    virtual void advance(CvMat * source);	// the whole new 8-bit source image
+    virtual void produce(ofxSaliencyMapNodeContext & context) = 0;
+
+    void addDependency(const string & name);
+    inline const string & getName(){ return mName; }
+    inline const vector<string> & getDependencies(){ return mDependencies; }
+
+protected:
+
+    string mName;
+    vector<string> mDependencies;
+
+};
+
+// built-in nodes
+class ofxSaliencyMapRGBINode : public ofxSaliencyMapNode {
+public:
+    ofxSaliencyMapRGBINode();
+    void produce(ofxSaliencyMapNodeContext & context);
+};
+
+class ofxSaliencyMapIntensityPyramidNode : public ofxSaliencyMapNode {
+public:
+    ofxSaliencyMapIntensityPyramidNode();
+    void produce(ofxSaliencyMapNodeContext & context);
+};
+
+class ofxSaliencyMapOpponencyNode : public ofxSaliencyMapNode {
+public:
+    ofxSaliencyMapOpponencyNode();
+    void produce(ofxSaliencyMapNodeContext & context);
+};
+
+// keeps the 8-bit intensity of the last two source images; a resolution change restarts the pair
+class ofxSaliencyMapMotionNode : public ofxSaliencyMapNode {
+public:
+    ofxSaliencyMapMotionNode();
+    ~ofxSaliencyMapMotionNode();
+    void advance(CvMat * source);
+    void produce(ofxSaliencyMapNodeContext & context);
+private:
+    CvMat * prev_frame;
+    CvMat * cur_frame;
+};
+
+#endif
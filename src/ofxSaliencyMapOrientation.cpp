@@ -0,0 +1,454 @@
+/**
+ ofxSaliencyMapOrientation.cpp https://github.com/TatsuyaOGth/ofxSaliencyMap
+
+ Copyright (c) 2014 TatsuyaOGth http://ogsn.org
+
+ This software is released under the MIT License.
+ http://opensource.org/licenses/mit-license.php
+ */
+#include "ofxSaliencyMapOrientation.h"
+#include "ofxSaliencyMapMemory.h"
+
+// Gabor kernels (9x9) of the four canonical orientations
+static const double	GaborKernel_0[9][9] = {
+    
+    {1.85212E-06,	1.28181E-05,	-0.000350433,	-0.000136537, 0.002010422,	-0.000136537,	-0.000350433,	1.28181E-05, 1.85212E-06},
+    {2.80209E-05,	0.000193926,	-0.005301717,	-0.002065674, 0.030415784,	-0.002065674,	-0.005301717,	0.000193926, 2.80209E-05},
+    {0.000195076,	0.001350077,	-0.036909595,   -0.014380852,   0.211749204,	-0.014380852,	-0.036909595, 0.001350077,	0.000195076},
+    {0.00062494,	0.004325061,	-0.118242318,	-0.046070008, 0.678352526,	-0.046070008,	-0.118242318,	0.004325061, 0.00062494},
+    {0.000921261,	0.006375831,	-0.174308068, -0.067914552,	1,	 -0.067914552,	-0.174308068, 0.006375831,	0.000921261},
+    {0.00062494,	0.004325061,	-0.118242318,	-0.046070008, 0.678352526,	-0.046070008,	-0.118242318,	0.004325061, 0.00062494},
+    {0.000195076,	0.001350077,	-0.036909595, -0.014380852,	0.211749204,	-0.014380852,	-0.036909595, 0.001350077,	0.000195076},
+    {2.80209E-05,	0.000193926,	-0.005301717,	-0.002065674, 0.030415784,	-0.002065674,	-0.005301717,	0.000193926, 2.80209E-05},
+    {1.85212E-06,	1.28181E-05,	-0.000350433,	-0.000136537, 0.002010422,	-0.000136537,	-0.000350433,	1.28181E-05, 1.85212E-06}
+    
+};
+static const double	GaborKernel_45[9][9] = {
+    
+    {4.0418E-06,	2.2532E-05,	 -0.000279806,	-0.001028923, 3.79931E-05,	0.000744712,	0.000132863,	-9.04408E-06, -1.01551E-06},
+    {2.2532E-05,	0.00092512,	 0.002373205,	-0.013561362, -0.0229477,	 0.000389916,	0.003516954	,	0.000288732, -9.04408E-06},
+    {-0.000279806,	0.002373205,	0.044837725,	0.052928748, -0.139178011,	-0.108372072,	0.000847346	,	0.003516954, 0.000132863},
+    {-0.001028923,	-0.013561362,	0.052928748,	0.46016215, 0.249959607,	-0.302454279,	-0.108372072,	0.000389916, 0.000744712},
+    {3.79931E-05,	-0.0229477,	 -0.139178011,	0.249959607, 1,	 0.249959607,	-0.139178011,	-0.0229477,	 3.79931E-05},
+    {0.000744712,	0.000389916,	-0.108372072, -0.302454279,	0.249959607,	0.46016215,	 0.052928748, -0.013561362,	-0.001028923},
+    {0.000132863,	0.003516954,	0.000847346,	-0.108372072, -0.139178011,	0.052928748,	0.044837725,	0.002373205, -0.000279806},
+    {-9.04408E-06,	0.000288732,	0.003516954,	0.000389916, -0.0229477,	 -0.013561362,	0.002373205,	0.00092512, 2.2532E-05},
+    {-1.01551E-06,	-9.04408E-06,	0.000132863,	0.000744712, 3.79931E-05,	-0.001028923,	-0.000279806,	2.2532E-05, 4.0418E-06}
+    
+};
+static const double GaborKernel_90[9][9] = {
+    
+    {1.85212E-06,	2.80209E-05,	0.000195076,	0.00062494, 0.000921261,	0.00062494,	 0.000195076,	2.80209E-05, 1.85212E-06},
+    {1.28181E-05,	0.000193926,	0.001350077,	0.004325061, 0.006375831,	0.004325061,	0.001350077,	0.000193926, 1.28181E-05},
+    {-0.000350433,	-0.005301717,	-0.036909595, -0.118242318,	-0.174308068,	-0.118242318, -0.036909595,	-0.005301717,	-0.000350433},
+    {-0.000136537,	-0.002065674,	-0.014380852, -0.046070008,	-0.067914552,	-0.046070008, -0.014380852,	-0.002065674,	-0.000136537},
+    {0.002010422,	0.030415784,	0.211749204,	0.678352526, 1,	 0.678352526,	0.211749204,	0.030415784, 0.002010422},
+    {-0.000136537,	-0.002065674,	-0.014380852, -0.046070008,	-0.067914552,	-0.046070008, -0.014380852,	-0.002065674,	-0.000136537},
+    {-0.000350433,	-0.005301717,	-0.036909595, -0.118242318,	-0.174308068,	-0.118242318, -0.036909595,	-0.005301717,	-0.000350433},
+    {1.28181E-05,	0.000193926,	0.001350077,	0.004325061, 0.006375831,	0.004325061,	0.001350077,	0.000193926, 1.28181E-05},
+    {1.85212E-06,	2.80209E-05,	0.000195076,	0.00062494, 0.000921261,	0.00062494,	 0.000195076,	2.80209E-05, 1.85212E-06}
+    
+};
+static const double	GaborKernel_135[9][9] = {
+    
+    {-1.01551E-06,	-9.04408E-06,	0.000132863,	0.000744712, 3.79931E-05,	-0.001028923,	-0.000279806,	2.2532E-05, 4.0418E-06},
+    {-9.04408E-06,	0.000288732,	0.003516954,	0.000389916, -0.0229477,	 -0.013561362,	0.002373205,	0.00092512, 2.2532E-05},
+    {0.000132863,	0.003516954,	0.000847346,	-0.108372072, -0.139178011,	0.052928748,	0.044837725,	0.002373205, -0.000279806},
+    {0.000744712,	0.000389916,	-0.108372072, -0.302454279,	0.249959607,	0.46016215,	 0.052928748, -0.013561362,	-0.001028923},
+    {3.79931E-05,	-0.0229477,	 -0.139178011,	0.249959607, 1,	 0.249959607,	-0.139178011,	-0.0229477,	 3.79931E-05},
+    {-0.001028923,	-0.013561362,	0.052928748,	0.46016215, 0.249959607	,	-0.302454279,	-0.108372072,	0.000389916, 0.000744712},
+    {-0.000279806,	0.002373205,	0.044837725,	0.052928748, -0.139178011,	-0.108372072,	0.000847346,	0.003516954, 0.000132863},
+    {2.2532E-05,	0.00092512,	 0.002373205,	-0.013561362, -0.0229477,	 0.000389916,	0.003516954,	0.000288732, -9.04408E-06},
+    {4.0418E-06,	2.2532E-05,	 -0.000279806,	-0.001028923, 3.79931E-05	,	0.000744712,	0.000132863,	-9.04408E-06, -1.01551E-06}
+    
+};
+
+static const double * GaborKernelTable(int index)
+{
+    switch (index) {
+        case 0: return &GaborKernel_0[0][0];
+        case 1: return &GaborKernel_45[0][0];
+        case 2: return &GaborKernel_90[0][0];
+        case 3: return &GaborKernel_135[0][0];
+    }
+    return NULL;
+}
+
+// index of the table matching an angle, or -1
+static int GaborCanonicalIndex(float degrees)
+{
+    double a = fmod((double)degrees, 180.0);
+    if (a < 0) a += 180.0;
+    int index = (int)floor(a / 45.0 + 0.5);
+    if (fabs(a - index * 45.0) > 0.001) return -1;
+    return index % 4;
+}
+
+// whether the separable engine can filter every angle
+static bool GaborCanonicalAngles(const vector<float> & degrees)
+{
+    for (int i=0; i<degrees.size(); i++) if (GaborCanonicalIndex(degrees[i]) < 0) return false;
+    return true;
+}
+
+static void GaborDefaultAngles(vector<float> & degrees)
+{
+    degrees.clear();
+    degrees.push_back(0);
+    degrees.push_back(45);
+    degrees.push_back(90);
+    degrees.push_back(135);
+}
+
+ofxSaliencyMapOrientation::ofxSaliencyMapOrientation()
+{
+    bSetup = false;
+    mMode = OFXSALIENCYMAP_ORIENTATION_DENSE;
+    mTolerance = OFXSALIENCYMAP_DEF_ORIENTATION_TOLERANCE;
+    GaborDefaultAngles(mAngles);
+}
+
+ofxSaliencyMapOrientation::~ofxSaliencyMapOrientation()
+{
+    clear();
+}
+
+bool ofxSaliencyMapOrientation::setup(const ofxSaliencyMapOrientationMode mode)
+{
+    
+    if (mode == OFXSALIENCYMAP_ORIENTATION_SEPARABLE && !GaborCanonicalAngles(mAngles)) {
+        cout << "[ERROR] the separable orientation engine only filters 0, 45, 90 and 135 degrees" << endl;
+        return false;
+    }
+    
+    clear();
+    mMode = mode;
+    buildReference();
+    if (mMode == OFXSALIENCYMAP_ORIENTATION_SEPARABLE) buildTerms();
+    
+    // fidelity of every orientation against its reference kernel
+    CvMat * effective = SMCreateMat(9, 9, CV_32FC1);
+    for (int i=0; i<mAngles.size(); i++)
+    {
+        
+        getEffectiveKernel(i, effective);
+        mFidelity.push_back(cvNorm(effective, mReference[i], CV_L2) / cvNorm(mReference[i], NULL, CV_L2));
+        
+    }
+    SMReleaseMat(&effective);
+    bSetup = true;
+    return true;
+    
+}
+
+bool ofxSaliencyMapOrientation::setOrientations(const vector<float> & degrees)
+{
+    
+    vector<float> angles = degrees;
+    if (angles.empty()) GaborDefaultAngles(angles);
+    if (angles.size() > OFXSALIENCYMAP_MAX_ORIENTATIONS) {
+        cout << "[ERROR] too many orientations, using the first " << OFXSALIENCYMAP_MAX_ORIENTATIONS << endl;
+        angles.resize(OFXSALIENCYMAP_MAX_ORIENTATIONS);
+    }
+    if (bSetup && mMode == OFXSALIENCYMAP_ORIENTATION_SEPARABLE && !GaborCanonicalAngles(angles)) {
+        cout << "[ERROR] the separable orientation engine only filters 0, 45, 90 and 135 degrees" << endl;
+        return false;
+    }
+    mAngles = angles;
+    return bSetup ? setup(mMode) : true;
+    
+}
+
+void ofxSaliencyMapOrientation::setTolerance(const double tolerance)
+{
+    mTolerance = tolerance;
+    if (bSetup) setup(mMode);
+}
+
+void ofxSaliencyMapOrientation::filter(CvMat * src, CvMat * dst[])
+{
+    
+    int height = src->height;
+    int width = src->width;
+    int num_angles = mAngles.size();
+    for (int i=0; i<num_angles; i++) dst[i] = SMCreateMat(height, width, CV_32FC1);
+    
+    if (mMode == OFXSALIENCYMAP_ORIENTATION_DENSE)
+    {
+        
+        for (int i=0; i<num_angles; i++) cvFilter2D(src, dst[i], mReference[i]);
+        return;
+        
+    }
+    
+    // one vertical pass per shared column kernel into the same scratch map, then the row
+    // passes of every term on that column. the first term of an orientation is written to
+    // its output directly, later ones go through the second scratch map and are added
+    CvMat * columnOutput = SMCreateMat(height, width, CV_32FC1);
+    CvMat * rowOutput = NULL;
+    vector<bool> written(num_angles, false);
+    for (int c=0; c<mColumns.size(); c++)
+    {
+        
+        bool filtered = false;
+        for (int i=0; i<num_angles; i++)
+        {
+            
+            const vector<Term> & terms = mTableTerms[GaborCanonicalIndex(mAngles[i])];
+            for (int k=0; k<terms.size(); k++)
+            {
+                
+                if (terms[k].column != c) continue;
+                if (!filtered) {
+                    cvFilter2D(src, columnOutput, mColumns[c]);
+                    filtered = true;
+                }
+                if (!written[i]) {
+                    cvFilter2D(columnOutput, dst[i], mRows[terms[k].row]);
+                    written[i] = true;
+                    continue;
+                }
+                if (rowOutput == NULL) rowOutput = SMCreateMat(height, width, CV_32FC1);
+                cvFilter2D(columnOutput, rowOutput, mRows[terms[k].row]);
+                cvAdd(dst[i], rowOutput, dst[i]);
+                
+            }
+            
+        }
+        
+    }
+    for (int i=0; i<num_angles; i++) if (!written[i]) cvSetZero(dst[i]);
+    SMReleaseMat(&columnOutput);
+    SMReleaseMat(&rowOutput);
+    
+}
+
+double ofxSaliencyMapOrientation::getFidelityError(const int index)
+{
+    if (index < 0 || index >= mFidelity.size()) return 0;
+    return mFidelity[index];
+}
+
+bool ofxSaliencyMapOrientation::checkFidelity(const double tolerance)
+{
+    
+    for (int i=0; i<mFidelity.size(); i++)
+    {
+        
+        if (mFidelity[i] > tolerance) return false;
+        
+    }
+    return true;
+    
+}
+
+int ofxSaliencyMapOrientation::getMultiplyAdds()
+{
+    
+    if (mMode == OFXSALIENCYMAP_ORIENTATION_DENSE) return 81 * mAngles.size();
+    
+    // every column kernel in use once, every term of every orientation once
+    vector<bool> usedColumn(mColumns.size(), false);
+    int rows = 0;
+    for (int i=0; i<mAngles.size(); i++)
+    {
+        
+        const vector<Term> & terms = mTableTerms[GaborCanonicalIndex(mAngles[i])];
+        for (int k=0; k<terms.size(); k++) usedColumn[terms[k].column] = true;
+        rows += terms.size();
+        
+    }
+    int columns = 0;
+    for (int c=0; c<usedColumn.size(); c++) if (usedColumn[c]) columns++;
+    return 9 * (columns + rows);
+    
+}
+
+void ofxSaliencyMapOrientation::clear()
+{
+    
+    for (int i=0; i<mReference.size(); i++) SMReleaseMat(&mReference[i]);
+    for (int i=0; i<mColumns.size(); i++) SMReleaseMat(&mColumns[i]);
+    for (int i=0; i<mRows.size(); i++) SMReleaseMat(&mRows[i]);
+    mReference.clear();
+    mColumns.clear();
+    mRows.clear();
+    for (int t=0; t<4; t++) mTableTerms[t].clear();
+    mFidelity.clear();
+    bSetup = false;
+    
+}
+
+void ofxSaliencyMapOrientation::buildReference()
+{
+    
+    // the tables for canonical angles, a bilinear rotation of the 0 degree kernel otherwise
+    for (int n=0; n<mAngles.size(); n++)
+    {
+        
+        CvMat * kernel = SMCreateMat(9, 9, CV_32FC1);
+        int index = GaborCanonicalIndex(mAngles[n]);
+        if (index >= 0)
+        {
+            
+            const double * table = GaborKernelTable(index);
+            for(int i=0; i<9; i++) for(int j=0; j<9; j++) cvmSet(kernel, i, j, table[i*9+j]);
+            
+        }
+        else
+        {
+            
+            double rad = mAngles[n] * PI / 180.0;
+            double c = cos(rad);
+            double s = sin(rad);
+            for(int i=0; i<9; i++) for(int j=0; j<9; j++)
+            {
+                
+                // counter-clockwise in image coordinates, as 0 -> 45 degrees in the tables
+                double x = (j-4) * c - (i-4) * s + 4;
+                double y = (j-4) * s + (i-4) * c + 4;
+                int x0 = (int)floor(x);
+                int y0 = (int)floor(y);
+                double fx = x - x0;
+                double fy = y - y0;
+                double v = 0;
+                for (int dy=0; dy<2; dy++) for (int dx=0; dx<2; dx++)
+                {
+                    
+                    int xx = x0 + dx;
+                    int yy = y0 + dy;
+                    if (xx < 0 || xx > 8 || yy < 0 || yy > 8) continue;
+                    v += GaborKernel_0[yy][xx] * (dx ? fx : 1-fx) * (dy ? fy : 1-fy);
+                    
+                }
+                cvmSet(kernel, i, j, v);
+                
+            }
+            
+        }
+        mReference.push_back(kernel);
+        
+    }
+    
+}
+
+void ofxSaliencyMapOrientation::buildTerms()
+{
+    
+    CvMat * kernel = SMCreateMat(9, 9, CV_32FC1);
+    for (int t=0; t<3; t++)
+    {
+        
+        const double * table = GaborKernelTable(t);
+        for(int i=0; i<9; i++) for(int j=0; j<9; j++) cvmSet(kernel, i, j, table[i*9+j]);
+        addSVDTerms(kernel, mTableTerms[t]);
+        
+    }
+    SMReleaseMat(&kernel);
+    
+    // 135 degrees: the 45 degree terms mirrored left to right, on the same columns
+    for (int k=0; k<mTableTerms[1].size(); k++)
+    {
+        
+        CvMat * row = SMCreateMat(1, 9, CV_32FC1);
+        CvMat * mirrored = mRows[mTableTerms[1][k].row];
+        for (int j=0; j<9; j++) cvmSet(row, 0, j, cvmGet(mirrored, 0, 8-j));
+        mRows.push_back(row);
+        Term term;
+        term.column = mTableTerms[1][k].column;
+        term.row = mRows.size() - 1;
+        mTableTerms[3].push_back(term);
+        
+    }
+    
+}
+
+void ofxSaliencyMapOrientation::addSVDTerms(CvMat * kernel, vector<Term> & terms)
+{
+    
+    // kernel = U * diag(W) * V^T; terms are added until the remainder is within tolerance
+    CvMat * A = SMCreateMat(9, 9, CV_64FC1);
+    CvMat * W = SMCreateMat(9, 1, CV_64FC1);
+    CvMat * U = SMCreateMat(9, 9, CV_64FC1);
+    CvMat * V = SMCreateMat(9, 9, CV_64FC1);
+    cvConvert(kernel, A);
+    cvSVD(A, W, U, V, 0);
+    
+    double total = 0;
+    for (int k=0; k<9; k++) total += cvmGet(W, k, 0) * cvmGet(W, k, 0);
+    double remainder = total;
+    
+    for (int k=0; k<9; k++)
+    {
+        
+        if (remainder <= total * mTolerance * mTolerance) break;
+        double sv = cvmGet(W, k, 0);
+        remainder -= sv * sv;
+        
+        // share the column kernel with an earlier table when it matches up to sign
+        int column = -1;
+        double sign = 1;
+        for (int c=0; c<mColumns.size() && column<0; c++)
+        {
+            
+            double dot = 0;
+            for (int i=0; i<9; i++) dot += cvmGet(mColumns[c], i, 0) * cvmGet(U, i, k);
+            if (fabs(fabs(dot) - 1) < 1e-6) {
+                column = c;
+                sign = dot < 0 ? -1 : 1;
+            }
+            
+        }
+        if (column < 0)
+        {
+            
+            CvMat * col = SMCreateMat(9, 1, CV_32FC1);
+            for (int i=0; i<9; i++) cvmSet(col, i, 0, cvmGet(U, i, k));
+            mColumns.push_back(col);
+            column = mColumns.size() - 1;
+            
+        }
+        
+        CvMat * row = SMCreateMat(1, 9, CV_32FC1);
+        for (int j=0; j<9; j++) cvmSet(row, 0, j, sign * sv * cvmGet(V, j, k));
+        mRows.push_back(row);
+        Term term;
+        term.column = column;
+        term.row = mRows.size() - 1;
+        terms.push_back(term);
+        
+    }
+    
+    SMReleaseMat(&A);
+    SMReleaseMat(&W);
+    SMReleaseMat(&U);
+    SMReleaseMat(&V);
+    
+}
+
+void ofxSaliencyMapOrientation::getEffectiveKernel(const int index, CvMat * dst)
+{
+    
+    if (mMode == OFXSALIENCYMAP_ORIENTATION_DENSE) {
+        cvCopy(mReference[index], dst);
+        return;
+    }
+    
+    // sum of the outer products of the orientation's terms
+    cvSetZero(dst);
+    const vector<Term> & terms = mTableTerms[GaborCanonicalIndex(mAngles[index])];
+    for (int k=0; k<terms.size(); k++)
+    {
+        
+        CvMat * col = mColumns[terms[k].column];
+        CvMat * row = mRows[terms[k].row];
+        for(int i=0; i<9; i++) for(int j=0; j<9; j++)
+        {
+            
+            cvmSet(dst, i, j, cvmGet(dst, i, j) + cvmGet(col, i, 0) * cvmGet(row, 0, j));
+            
+        }
+        
+    }
+    
+}
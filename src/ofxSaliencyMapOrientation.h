@@ -0,0 +1,89 @@
+/**
+ ofxSaliencyMapOrientation.h https://github.com/TatsuyaOGth/ofxSaliencyMap
+
+ Copyright (c) 2014 TatsuyaOGth http://ogsn.org
+
+ This software is released under the MIT License.
+ http://opensource.org/licenses/mit-license.php
+ */
+#ifndef _OFX_SALIENCY_MAP_ORIENTATION_H_
+#define _OFX_SALIENCY_MAP_ORIENTATION_H_
+
+#include "ofMain.h"
+#include "ofxCv.h"
+
+static const int    OFXSALIENCYMAP_MAX_ORIENTATIONS             = 8;
+static const double OFXSALIENCYMAP_DEF_ORIENTATION_TOLERANCE    = 0.01;	// relative kernel error of the separable terms
+
+enum ofxSaliencyMapOrientationMode {
+    OFXSALIENCYMAP_ORIENTATION_DENSE,		// one 9x9 cvFilter2D per orientation (default, exact, any angle)
+    OFXSALIENCYMAP_ORIENTATION_SEPARABLE	// 9x1 column and 1x9 row passes, 0/45/90/135 degrees only (opt-in)
+};
+
+// Gabor orientation filter bank.
+//
+// The 0 and 90 degree Gabor kernels are exact outer products of two 9-tap
+// vectors, and the 135 degree kernel is the 45 degree one mirrored left to right.
+// The separable engine splits the 0, 45 and 90 degree kernels with an SVD into
+// 9x1 column and 1x9 row kernels, dropping terms below the tolerance, and reuses
+// the 45 degree terms for 135 with reversed row kernels. The four orientations
+// then cost 5 column and 8 row passes of 9 taps (117 multiply-adds per pixel
+// instead of 324, see getMultiplyAdds()).
+//
+// Other angles are bilinear rotations of the 0 degree kernel and are filtered
+// densely. They are not steerable from the table terms, and a basis fitted over
+// all rotations of this kernel needs about 12 9x9 kernels for 1% error, more work
+// than filtering the orientations themselves, so the separable engine rejects them.
+class ofxSaliencyMapOrientation {
+public:
+
+    ofxSaliencyMapOrientation();
+    virtual ~ofxSaliencyMapOrientation();
+
+    // both return false, and change nothing, when the separable engine would get an
+    // angle other than 0, 45, 90 or 135 (modulo 180)
+    bool setup(const ofxSaliencyMapOrientationMode mode);
+    bool setOrientations(const vector<float> & degrees);	// empty: 0, 45, 90, 135 (the default)
+    void setTolerance(const double tolerance);	// relative kernel error the separable terms may have
+
+    // filters src with every orientation, allocating dst[0..getNumOrientations()-1]
+    void filter(CvMat * src, CvMat * dst[]);
+
+    // relative Frobenius error of the kernel in use against the reference kernel
+    double getFidelityError(const int index);
+    bool checkFidelity(const double tolerance = OFXSALIENCYMAP_DEF_ORIENTATION_TOLERANCE);
+    // multiply-adds per pixel of the filter passes of filter()
+    int getMultiplyAdds();
+
+    inline bool isSetup(){ return bSetup; }
+    inline ofxSaliencyMapOrientationMode getMode(){ return mMode; }
+    inline int getNumOrientations(){ return mAngles.size(); }
+    inline float getOrientation(const int index){ return mAngles[index]; }
+
+private:
+
+    // one separable term: column kernel (shared) followed by a row kernel
+    struct Term {
+        int column;
+        int row;
+    };
+
+    bool bSetup;
+    ofxSaliencyMapOrientationMode mMode;
+    vector<float> mAngles;
+    double mTolerance;
+
+    vector<CvMat *> mReference;	// 9x9 reference kernel per orientation (also the dense kernels)
+    vector<CvMat *> mColumns;	// 9x1
+    vector<CvMat *> mRows;	// 1x9
+    vector<Term> mTableTerms[4];	// terms of each table
+    vector<double> mFidelity;
+
+    void clear();
+    void buildReference();
+    void buildTerms();
+    void addSVDTerms(CvMat * kernel, vector<Term> & terms);
+    void getEffectiveKernel(const int index, CvMat * dst);
+
+};
+#endif
@@ -0,0 +1,77 @@
+/**
+ ofxSaliencyMapScales.h https://github.com/TatsuyaOGth/ofxSaliencyMap
+
+ Copyright (c) 2014 TatsuyaOGth http://ogsn.org
+
+ This software is released under the MIT License.
+ http://opensource.org/licenses/mit-license.php
+ */
+#ifndef _OFX_SALIENCY_MAP_SCALES_H_
+#define _OFX_SALIENCY_MAP_SCALES_H_
+
+static const int OFXSALIENCYMAP_MAX_PYRAMID_LEVELS  = 9;
+static const int OFXSALIENCYMAP_MAX_FEATURE_MAPS    = 6;	// center-surround maps per pyramid
+static const int OFXSALIENCYMAP_DEF_MIN_TOP_LEVEL   = 3;	// shortest side of the coarsest level chosen by OFXSALIENCYMAP_SCALES_AUTO
+
+enum ofxSaliencyMapScaleSet {
+    OFXSALIENCYMAP_SCALES_AUTO,		// deepest preset that leaves no degenerate level for the source size
+    OFXSALIENCYMAP_SCALES_DEFAULT,	// 9 levels, centers 2-4, surrounds center+3/+4 (Itti et al.)
+    OFXSALIENCYMAP_SCALES_VGA,		// 8 levels, centers 2-3 (640x480: coarsest level 5x3)
+    OFXSALIENCYMAP_SCALES_QVGA,		// 7 levels, centers 1-2 (320x240: coarsest level 5x3)
+    OFXSALIENCYMAP_SCALES_QQVGA		// 6 levels, centers 1-2, surrounds center+2/+3 (160x120: coarsest level 5x3)
+};
+
+// runtime description of a scale set
+struct ofxSaliencyMapScaleInfo {
+    int levels;
+    int centerBegin;
+    int centerEnd;
+    int delta0;
+    int delta1;
+    int numMaps;
+    int minSize;
+};
+
+// Gaussian pyramid depth and center-surround scales as compile-time constants:
+// centers are levels [CenterBegin, CenterEnd), surrounds are center + Delta0 and center + Delta1.
+template<int NumLevels, int CenterBegin, int CenterEnd, int Delta0, int Delta1>
+struct ofxSaliencyMapScales {
+
+    enum {
+        LEVELS          = NumLevels,
+        CENTER_BEGIN    = CenterBegin,
+        CENTER_END      = CenterEnd,
+        DELTA0          = Delta0,
+        DELTA1          = Delta1,
+        NUM_MAPS        = 2 * (CenterEnd - CenterBegin),
+        MIN_SIZE        = 1 << (NumLevels - 1)	// shortest source side with a non-empty coarsest level
+    };
+
+    // compile-time checks (array of negative size on failure)
+    typedef char check_levels[(NumLevels >= 2 && NumLevels <= OFXSALIENCYMAP_MAX_PYRAMID_LEVELS) ? 1 : -1];
+    typedef char check_centers[(CenterBegin >= 0 && CenterBegin < CenterEnd) ? 1 : -1];
+    typedef char check_surrounds[(Delta0 > 0 && Delta0 < Delta1 && CenterEnd - 1 + Delta1 < NumLevels) ? 1 : -1];
+    typedef char check_maps[(2 * (CenterEnd - CenterBegin) <= OFXSALIENCYMAP_MAX_FEATURE_MAPS) ? 1 : -1];
+
+    static ofxSaliencyMapScaleInfo info()
+    {
+        ofxSaliencyMapScaleInfo i;
+        i.levels = LEVELS;
+        i.centerBegin = CENTER_BEGIN;
+        i.centerEnd = CENTER_END;
+        i.delta0 = DELTA0;
+        i.delta1 = DELTA1;
+        i.numMaps = NUM_MAPS;
+        i.minSize = MIN_SIZE;
+        return i;
+    }
+
+};
+
+// ready-made specializations
+typedef ofxSaliencyMapScales<9, 2, 5, 3, 4> ofxSaliencyMapScalesDefault;
+typedef ofxSaliencyMapScales<8, 2, 4, 3, 4> ofxSaliencyMapScalesVGA;
+typedef ofxSaliencyMapScales<7, 1, 3, 3, 4> ofxSaliencyMapScalesQVGA;
+typedef ofxSaliencyMapScales<6, 1, 3, 2, 3> ofxSaliencyMapScalesQQVGA;
+
+#endif
@@ -0,0 +1,434 @@
+/**
+ ofxSaliencyMapSequence.cpp https://github.com/TatsuyaOGth/ofxSaliencyMap
+
+ Copyright (c) 2014 TatsuyaOGth http://ogsn.org
+
+ This software is released under the MIT License.
+ http://opensource.org/licenses/mit-license.php
+ */
+#include "ofxSaliencyMapSequence.h"
+#include "ofxSaliencyMap.h"
+
+#ifndef TARGET_WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+static const char SEQUENCE_MAGIC[8] = { 'O', 'F', 'X', 'S', 'M', 'S', 'E', 'Q' };
+static const char CHUNK_MAGIC[4] = { 'F', 'R', 'A', 'M' };
+
+uint64_t SMAlignUp(uint64_t size, uint64_t alignment)
+{
+    return (size + alignment - 1) / alignment * alignment;
+}
+
+//////////////////////////////////////////////////////////////////
+// Writer
+//////////////////////////////////////////////////////////////////
+ofxSaliencyMapSequenceWriter::ofxSaliencyMapSequenceWriter()
+{
+    file = NULL;
+    memset(&header, 0, sizeof(header));
+}
+
+ofxSaliencyMapSequenceWriter::~ofxSaliencyMapSequenceWriter()
+{
+    close();
+}
+
+bool ofxSaliencyMapSequenceWriter::open(const string & path, const int width, const int height, const vector<string> & planes,
+                                        const int bitDepth, const int level)
+{
+    close();
+
+    int storedWidth = width;
+    int storedHeight = height;
+    for (int l=0; l<level; l++) {
+        storedWidth /= 2;
+        storedHeight /= 2;
+    }
+    if (width <= 0 || height <= 0 || level < 0 || storedWidth < 1 || storedHeight < 1) {
+        cout << "[ERROR] invalid sequence size or pyramid level" << endl;
+        return false;
+    }
+    if (bitDepth != 8 && bitDepth != 16) {
+        cout << "[ERROR] sequence bit depth must be 8 or 16" << endl;
+        return false;
+    }
+    if (planes.empty() || planes.size() > OFXSALIENCYMAP_SEQUENCE_MAX_PLANES) {
+        cout << "[ERROR] a sequence stores 1 to " << OFXSALIENCYMAP_SEQUENCE_MAX_PLANES << " planes" << endl;
+        return false;
+    }
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SEQUENCE_MAGIC, sizeof(header.magic));
+    header.version = OFXSALIENCYMAP_SEQUENCE_VERSION;
+    header.headerBytes = OFXSALIENCYMAP_SEQUENCE_PAGE_SIZE;
+    header.width = width;
+    header.height = height;
+    header.storedWidth = storedWidth;
+    header.storedHeight = storedHeight;
+    header.level = level;
+    header.bitDepth = bitDepth;
+    header.numPlanes = planes.size();
+    header.planeStride = storedWidth * (bitDepth / 8);
+    header.planeBytes = SMAlignUp((uint64_t)header.planeStride * storedHeight, OFXSALIENCYMAP_SEQUENCE_PLANE_ALIGN);
+    header.chunkBytes = SMAlignUp(sizeof(ofxSaliencyMapSequenceChunk) + header.planeBytes * header.numPlanes, OFXSALIENCYMAP_SEQUENCE_PAGE_SIZE);
+    for (int i=0; i<planes.size(); i++) {
+        if (planes[i].empty() || planes[i].size() >= OFXSALIENCYMAP_SEQUENCE_NAME_SIZE) {
+            cout << "[ERROR] invalid sequence plane name \"" << planes[i] << "\"" << endl;
+            return false;
+        }
+        strncpy(header.planeNames[i], planes[i].c_str(), OFXSALIENCYMAP_SEQUENCE_NAME_SIZE - 1);
+    }
+
+    file = fopen(ofToDataPath(path).c_str(), "wb");
+    if (file == NULL) {
+        cout << "[ERROR] cannot open " << path << endl;
+        return false;
+    }
+
+    // header page; the frame count and the index offset are filled in by close()
+    vector<unsigned char> page(header.headerBytes, 0);
+    memcpy(&page[0], &header, sizeof(header));
+    if (fwrite(&page[0], 1, page.size(), file) != page.size()) {
+        cout << "[ERROR] cannot write " << path << endl;
+        fclose(file);
+        file = NULL;
+        return false;
+    }
+    chunk.assign(header.chunkBytes, 0);
+    index.clear();
+    return true;
+}
+
+bool ofxSaliencyMapSequenceWriter::close()
+{
+    if (file == NULL) return true;
+
+    // frame index after the last chunk, then the final header. the header written by open()
+    // has no index (indexOffset 0), so whatever fails here, readers still scan the chunks
+    bool written = true;
+    header.numFrames = index.size();
+    header.indexOffset = header.headerBytes + header.numFrames * header.chunkBytes;
+    if ((!index.empty() && fwrite(&index[0], sizeof(ofxSaliencyMapSequenceIndexEntry), index.size(), file) != index.size()) ||
+        fflush(file) != 0) {
+        cout << "[ERROR] cannot write the sequence frame index, readers will scan the frame chunks" << endl;
+        header.indexOffset = 0;
+        written = false;
+    }
+    if (fseek(file, 0, SEEK_SET) != 0 || fwrite(&header, sizeof(header), 1, file) != 1) {
+        cout << "[ERROR] cannot write the final sequence header, readers will scan the frame chunks" << endl;
+        written = false;
+    }
+    if (fclose(file) != 0) {
+        cout << "[ERROR] cannot close the sequence file" << endl;
+        written = false;
+    }
+
+    file = NULL;
+    index.clear();
+    chunk.clear();
+    return written;
+}
+
+bool ofxSaliencyMapSequenceWriter::addFrame(ofxSaliencyMap & saliencyMap, const double timestamp)
+{
+    vector<const ofFloatPixels *> planes;
+    for (int i=0; i<header.numPlanes; i++) {
+        string name = header.planeNames[i];
+        if (name == "saliency") planes.push_back(&saliencyMap.getSaliencyMapFloat());
+        else planes.push_back(&saliencyMap.getConspicuityMap(name));
+
+        if (!planes.back()->isAllocated()) {
+            cout << "[ERROR] no float output for plane \"" << name << "\" (see setFloatOutputEnabled())" << endl;
+            return false;
+        }
+    }
+    return addFrame(planes, timestamp);
+}
+
+bool ofxSaliencyMapSequenceWriter::addFrame(const vector<const ofFloatPixels *> & planes, const double timestamp)
+{
+    if (file == NULL) return false;
+
+    if (planes.size() != header.numPlanes) {
+        cout << "[ERROR] sequence expects " << header.numPlanes << " planes per frame" << endl;
+        return false;
+    }
+    for (int i=0; i<planes.size(); i++) {
+        if (planes[i] == NULL || planes[i]->getNumChannels() != 1 ||
+            planes[i]->getWidth() != header.width || planes[i]->getHeight() != header.height) {
+            cout << "[ERROR] plane " << i << " does not match the sequence size" << endl;
+            return false;
+        }
+    }
+
+    memset(&chunk[0], 0, chunk.size());
+    ofxSaliencyMapSequenceChunk * chunkHeader = (ofxSaliencyMapSequenceChunk *)&chunk[0];
+    memcpy(chunkHeader->magic, CHUNK_MAGIC, sizeof(chunkHeader->magic));
+    chunkHeader->frame = index.size();
+    chunkHeader->timestamp = timestamp;
+    for (int i=0; i<planes.size(); i++) {
+        quantizePlane(*planes[i], &chunk[sizeof(ofxSaliencyMapSequenceChunk) + i * header.planeBytes]);
+    }
+
+    if (fwrite(&chunk[0], 1, chunk.size(), file) != chunk.size()) {
+        cout << "[ERROR] cannot write sequence frame " << index.size() << endl;
+        return false;
+    }
+
+    ofxSaliencyMapSequenceIndexEntry entry;
+    entry.offset = header.headerBytes + index.size() * header.chunkBytes;
+    entry.timestamp = timestamp;
+    index.push_back(entry);
+    return true;
+}
+
+void ofxSaliencyMapSequenceWriter::quantizePlane(const ofFloatPixels & src, unsigned char * dst)
+{
+
+    CvMat srcHeader;
+    cvInitMatHeader(&srcHeader, src.getHeight(), src.getWidth(), CV_32FC1, (void *)src.getPixels());
+
+    // low-resolution storage: the same reduction as the Gaussian pyramid
+    CvMat * level = &srcHeader;
+    CvMat * reduced = NULL;
+    for (int l=0; l<header.level; l++)
+    {
+
+        CvMat * down = SMCreateMat(level->rows / 2, level->cols / 2, CV_32FC1);
+        cvPyrDown(level, down, CV_GAUSSIAN_5x5);
+        SMReleaseMat(&reduced);
+        reduced = down;
+        level = down;
+
+    }
+
+    // round and saturate to the stored depth
+    CvMat dstHeader;
+    int type = header.bitDepth == 16 ? CV_16UC1 : CV_8UC1;
+    double scale = header.bitDepth == 16 ? 65535.0 : 255.0;
+    cvInitMatHeader(&dstHeader, header.storedHeight, header.storedWidth, type, dst, header.planeStride);
+    cvConvertScale(level, &dstHeader, scale, 0);
+    SMReleaseMat(&reduced);
+
+}
+
+//////////////////////////////////////////////////////////////////
+// Reader
+//////////////////////////////////////////////////////////////////
+ofxSaliencyMapSequenceReader::ofxSaliencyMapSequenceReader()
+{
+    memset(&header, 0, sizeof(header));
+    numFrames = 0;
+    base = NULL;
+    fileSize = 0;
+#ifdef TARGET_WIN32
+    fileHandle = NULL;
+    mappingHandle = NULL;
+#else
+    fd = -1;
+#endif
+}
+
+ofxSaliencyMapSequenceReader::~ofxSaliencyMapSequenceReader()
+{
+    close();
+}
+
+bool ofxSaliencyMapSequenceReader::open(const string & path)
+{
+    close();
+
+    if (!map(ofToDataPath(path))) {
+        cout << "[ERROR] cannot map " << path << endl;
+        return false;
+    }
+
+    // header. sizes are compared in 64 bits, and planeBytes is bounded by the file size
+    // before it is multiplied, so that no field can make a product wrap around
+    bool valid = fileSize >= sizeof(header);
+    if (valid) memcpy(&header, base, sizeof(header));
+    valid = valid && memcmp(header.magic, SEQUENCE_MAGIC, sizeof(header.magic)) == 0 &&
+            header.version == OFXSALIENCYMAP_SEQUENCE_VERSION &&
+            header.headerBytes >= sizeof(header) && header.headerBytes <= fileSize &&
+            (header.bitDepth == 8 || header.bitDepth == 16) &&
+            header.numPlanes >= 1 && header.numPlanes <= OFXSALIENCYMAP_SEQUENCE_MAX_PLANES &&
+            header.width >= 1 && header.height >= 1 && header.level < 32 &&
+            header.storedWidth == (header.width >> header.level) && header.storedHeight == (header.height >> header.level) &&
+            header.storedWidth >= 1 && header.storedHeight >= 1 &&
+            header.planeStride >= (uint64_t)header.storedWidth * (header.bitDepth / 8) &&
+            header.planeBytes >= (uint64_t)header.planeStride * header.storedHeight &&
+            header.planeBytes <= fileSize &&
+            header.chunkBytes >= sizeof(ofxSaliencyMapSequenceChunk) + header.planeBytes * header.numPlanes;
+    if (!valid) {
+        cout << "[ERROR] " << path << " is not a saliency map sequence" << endl;
+        close();
+        return false;
+    }
+    for (int i=0; i<OFXSALIENCYMAP_SEQUENCE_MAX_PLANES; i++) header.planeNames[i][OFXSALIENCYMAP_SEQUENCE_NAME_SIZE - 1] = '\0';
+
+    // a closed file holds numFrames whole chunks, then the index right after them
+    uint64_t chunksFit = (fileSize - header.headerBytes) / header.chunkBytes;
+    bool indexed = header.indexOffset != 0 && header.numFrames <= chunksFit &&
+                   header.indexOffset == header.headerBytes + header.numFrames * header.chunkBytes &&
+                   header.numFrames <= (fileSize - header.indexOffset) / sizeof(ofxSaliencyMapSequenceIndexEntry);
+    if (header.indexOffset != 0 && !indexed) {
+        cout << "[WARNING] " << path << " has a corrupt frame index, reading its chunks instead" << endl;
+    }
+
+    if (indexed)
+    {
+
+        // closed file: frame index
+        const ofxSaliencyMapSequenceIndexEntry * entries = (const ofxSaliencyMapSequenceIndexEntry *)(base + header.indexOffset);
+        for (uint64_t i=0; i<header.numFrames; i++) {
+            uint64_t offset = entries[i].offset;
+            if (offset < header.headerBytes || (offset - header.headerBytes) % header.chunkBytes != 0 ||
+                (offset - header.headerBytes) / header.chunkBytes >= chunksFit) break;
+            offsets.push_back(offset);
+            timestamps.push_back(entries[i].timestamp);
+        }
+
+    }
+    else
+    {
+
+        // the writer did not finish: every complete chunk
+        for (uint64_t offset = header.headerBytes; offset + header.chunkBytes <= fileSize; offset += header.chunkBytes) {
+            const ofxSaliencyMapSequenceChunk * chunk = (const ofxSaliencyMapSequenceChunk *)(base + offset);
+            if (memcmp(chunk->magic, CHUNK_MAGIC, sizeof(chunk->magic)) != 0) break;
+            offsets.push_back(offset);
+            timestamps.push_back(chunk->timestamp);
+        }
+
+    }
+    numFrames = offsets.size();
+    return true;
+}
+
+void ofxSaliencyMapSequenceReader::close()
+{
+    unmap();
+    memset(&header, 0, sizeof(header));
+    numFrames = 0;
+    offsets.clear();
+    timestamps.clear();
+}
+
+string ofxSaliencyMapSequenceReader::getPlaneName(const int plane)
+{
+    if (plane < 0 || plane >= header.numPlanes) return "";
+    return header.planeNames[plane];
+}
+
+int ofxSaliencyMapSequenceReader::getPlaneIndex(const string & name)
+{
+    for (int i=0; i<header.numPlanes; i++) {
+        if (name == header.planeNames[i]) return i;
+    }
+    return -1;
+}
+
+double ofxSaliencyMapSequenceReader::getTimestamp(const int frame)
+{
+    if (frame < 0 || frame >= numFrames) return 0;
+    return timestamps[frame];
+}
+
+const void * ofxSaliencyMapSequenceReader::getPlaneData(const int frame, const int plane)
+{
+    if (frame < 0 || frame >= numFrames || plane < 0 || plane >= header.numPlanes) return NULL;
+    return base + offsets[frame] + sizeof(ofxSaliencyMapSequenceChunk) + plane * header.planeBytes;
+}
+
+bool ofxSaliencyMapSequenceReader::getPlaneMat(const int frame, const int plane, CvMat & dst)
+{
+    const void * data = getPlaneData(frame, plane);
+    if (data == NULL) return false;
+
+    int type = header.bitDepth == 16 ? CV_16UC1 : CV_8UC1;
+    cvInitMatHeader(&dst, header.storedHeight, header.storedWidth, type, (void *)data, header.planeStride);
+    return true;
+}
+
+bool ofxSaliencyMapSequenceReader::getPlane(const int frame, const int plane, ofFloatPixels & dst)
+{
+    CvMat src;
+    if (!getPlaneMat(frame, plane, src)) return false;
+
+    dst.allocate(header.storedWidth, header.storedHeight, OF_IMAGE_GRAYSCALE);
+    CvMat dstHeader;
+    cvInitMatHeader(&dstHeader, header.storedHeight, header.storedWidth, CV_32FC1, dst.getPixels());
+    cvConvertScale(&src, &dstHeader, header.bitDepth == 16 ? 1 / 65535.0 : 1 / 255.0, 0);
+    return true;
+}
+
+bool ofxSaliencyMapSequenceReader::map(const string & path)
+{
+#ifdef TARGET_WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+        CloseHandle(file);
+        return false;
+    }
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mapping == NULL) {
+        CloseHandle(file);
+        return false;
+    }
+    void * view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (view == NULL) {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+    fileHandle = file;
+    mappingHandle = mapping;
+    base = (const unsigned char *)view;
+    fileSize = size.QuadPart;
+#else
+    int file = ::open(path.c_str(), O_RDONLY);
+    if (file < 0) return false;
+
+    struct stat st;
+    if (fstat(file, &st) != 0 || st.st_size == 0 || (uint64_t)(size_t)st.st_size != (uint64_t)st.st_size) {
+        ::close(file);
+        return false;
+    }
+    void * view = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, file, 0);
+    if (view == MAP_FAILED) {
+        ::close(file);
+        return false;
+    }
+    fd = file;
+    base = (const unsigned char *)view;
+    fileSize = st.st_size;
+#endif
+    return true;
+}
+
+void ofxSaliencyMapSequenceReader::unmap()
+{
+    if (base == NULL) return;
+
+#ifdef TARGET_WIN32
+    UnmapViewOfFile(base);
+    CloseHandle(mappingHandle);
+    CloseHandle(fileHandle);
+    mappingHandle = NULL;
+    fileHandle = NULL;
+#else
+    munmap((void *)base, fileSize);
+    ::close(fd);
+    fd = -1;
+#endif
+    base = NULL;
+    fileSize = 0;
+}
@@ -0,0 +1,155 @@
+/**
+ ofxSaliencyMapSequence.h https://github.com/TatsuyaOGth/ofxSaliencyMap
+
+ Copyright (c) 2014 TatsuyaOGth http://ogsn.org
+
+ This software is released under the MIT License.
+ http://opensource.org/licenses/mit-license.php
+ */
+#ifndef _OFX_SALIENCY_MAP_SEQUENCE_H_
+#define _OFX_SALIENCY_MAP_SEQUENCE_H_
+
+#include "ofMain.h"
+#include "ofxCv.h"
+#include <stdint.h>
+
+class ofxSaliencyMap;
+
+static const int      OFXSALIENCYMAP_SEQUENCE_VERSION       = 1;
+static const int      OFXSALIENCYMAP_SEQUENCE_MAX_PLANES    = 8;
+static const int      OFXSALIENCYMAP_SEQUENCE_NAME_SIZE     = 32;
+static const uint64_t OFXSALIENCYMAP_SEQUENCE_PAGE_SIZE     = 4096;	// alignment of the header and every frame chunk
+static const uint64_t OFXSALIENCYMAP_SEQUENCE_PLANE_ALIGN   = 64;	// alignment of every plane inside a chunk
+
+// Saliency map sequence file (native byte order):
+//
+//   header                  one page
+//   frame chunk 0..n-1      page aligned, all of header.chunkBytes:
+//                           ofxSaliencyMapSequenceChunk, then header.numPlanes planes of
+//                           header.planeBytes (rows of header.planeStride bytes)
+//   frame index             header.numFrames ofxSaliencyMapSequenceIndexEntry
+//
+// plane values are 0-1 quantized to 8 or 16 bits. planes can be stored at a pyramid level
+// (each level halves the size like cvPyrDown). the index is written on close(); a file whose
+// writer did not finish is still readable from its chunk headers.
+struct ofxSaliencyMapSequenceHeader {
+    char magic[8];	// "OFXSMSEQ"
+    uint32_t version;
+    uint32_t headerBytes;
+    uint32_t width;	// source size
+    uint32_t height;
+    uint32_t storedWidth;
+    uint32_t storedHeight;
+    uint32_t level;	// pyramid level of the stored planes
+    uint32_t bitDepth;	// 8 or 16
+    uint32_t numPlanes;
+    uint32_t planeStride;
+    uint64_t planeBytes;
+    uint64_t chunkBytes;
+    uint64_t numFrames;
+    uint64_t indexOffset;	// 0 until the writer is closed
+    char planeNames[OFXSALIENCYMAP_SEQUENCE_MAX_PLANES][OFXSALIENCYMAP_SEQUENCE_NAME_SIZE];
+};
+
+struct ofxSaliencyMapSequenceChunk {
+    char magic[4];	// "FRAM"
+    uint32_t frame;
+    double timestamp;
+    char reserved[OFXSALIENCYMAP_SEQUENCE_PLANE_ALIGN - 16];
+};
+
+struct ofxSaliencyMapSequenceIndexEntry {
+    uint64_t offset;
+    double timestamp;
+};
+
+// the on-disk layout must not depend on the compiler (array of negative size on failure)
+typedef char ofxSaliencyMapSequenceCheckHeader[sizeof(ofxSaliencyMapSequenceHeader) <= OFXSALIENCYMAP_SEQUENCE_PAGE_SIZE ? 1 : -1];
+typedef char ofxSaliencyMapSequenceCheckChunk[sizeof(ofxSaliencyMapSequenceChunk) == OFXSALIENCYMAP_SEQUENCE_PLANE_ALIGN ? 1 : -1];
+typedef char ofxSaliencyMapSequenceCheckIndex[sizeof(ofxSaliencyMapSequenceIndexEntry) == 16 ? 1 : -1];
+
+// appends frames to a sequence file
+class ofxSaliencyMapSequenceWriter {
+public:
+
+    ofxSaliencyMapSequenceWriter();
+    virtual ~ofxSaliencyMapSequenceWriter();
+
+    // planes: "saliency" and/or channel names (see ofxSaliencyMap::getConspicuityMap()), in storage order
+    bool open(const string & path, const int width, const int height, const vector<string> & planes,
+              const int bitDepth = 8, const int level = 0);
+    bool close();	// writes the frame index; false if the index or the header could not be written
+
+    // the float outputs of the last delivered frame (requires ofxSaliencyMap::setFloatOutputEnabled(true))
+    bool addFrame(ofxSaliencyMap & saliencyMap, const double timestamp = 0);
+    // one 0-1 map per plane, of the size given to open()
+    bool addFrame(const vector<const ofFloatPixels *> & planes, const double timestamp = 0);
+
+    inline bool isOpen(){ return file != NULL; }
+    inline int getNumFrames(){ return index.size(); }
+
+private:
+
+    FILE * file;
+    ofxSaliencyMapSequenceHeader header;
+    vector<ofxSaliencyMapSequenceIndexEntry> index;
+    vector<unsigned char> chunk;
+
+    void quantizePlane(const ofFloatPixels & src, unsigned char * dst);
+
+};
+
+// zero-copy random access to a sequence file through a read-only memory mapping
+class ofxSaliencyMapSequenceReader {
+public:
+
+    ofxSaliencyMapSequenceReader();
+    virtual ~ofxSaliencyMapSequenceReader();
+
+    bool open(const string & path);
+    void close();
+
+    inline bool isOpen(){ return base != NULL; }
+    inline int getNumFrames(){ return numFrames; }
+    inline int getWidth(){ return header.width; }
+    inline int getHeight(){ return header.height; }
+    inline int getStoredWidth(){ return header.storedWidth; }
+    inline int getStoredHeight(){ return header.storedHeight; }
+    inline int getLevel(){ return header.level; }
+    inline int getBitDepth(){ return header.bitDepth; }
+    inline int getNumPlanes(){ return header.numPlanes; }
+    inline size_t getPlaneStride(){ return header.planeStride; }
+    string getPlaneName(const int plane);
+    int getPlaneIndex(const string & name);	// -1 if not stored
+    double getTimestamp(const int frame);
+
+    // pointers into the mapping, valid until close(); rows of getPlaneStride() bytes,
+    // uint8_t or uint16_t per pixel. NULL for an invalid frame or plane
+    const void * getPlaneData(const int frame, const int plane);
+    // CV_8UC1 / CV_16UC1 header over the same memory (read-only)
+    bool getPlaneMat(const int frame, const int plane, CvMat & dst);
+    // dequantized copy (0-1) at the stored size
+    bool getPlane(const int frame, const int plane, ofFloatPixels & dst);
+
+private:
+
+    ofxSaliencyMapSequenceHeader header;
+    int numFrames;
+    const unsigned char * base;
+    uint64_t fileSize;
+    vector<uint64_t> offsets;
+    vector<double> timestamps;
+
+#ifdef TARGET_WIN32
+    void * fileHandle;
+    void * mappingHandle;
+#else
+    int fd;
+#endif
+
+    bool map(const string & path);
+    void unmap();
+
+};
+
+#endif